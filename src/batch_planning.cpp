@@ -0,0 +1,122 @@
+//  Author:  Noah Himed
+//  Date:    16 October 2026
+//  Summary: Implements batch planning of deliveries files.
+
+#include "batch_planning.h"
+#include "delivery_io.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <set>
+#include <cerrno>
+#include <dirent.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+// adds path to files, or every regular file in it if it's a directory
+static void addDeliveriesFiles(const string& path, vector<string>& files)
+{
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0 || !S_ISDIR(info.st_mode))
+    {
+        files.push_back(path);
+        return;
+    }
+    DIR* dir = opendir(path.c_str());
+    if (dir == nullptr)
+        return;
+    vector<string> entries;
+    while (dirent* entry = readdir(dir))
+    {
+        string file = path + "/" + entry->d_name;
+        if (entry->d_name[0] != '.' && stat(file.c_str(), &info) == 0 && S_ISREG(info.st_mode))
+            entries.push_back(file);
+    }
+    closedir(dir);
+    // directories list in no particular order
+    sort(entries.begin(), entries.end());
+    files.insert(files.end(), entries.begin(), entries.end());
+}
+
+// the name of a file's plan: its name, less any extension, with .plan on
+// the end, and numbered if an earlier file's plan has that name already
+static string planName(const string& file, set<string>& taken)
+{
+    string name = file.substr(file.find_last_of('/') + 1);
+    size_t dot = name.find_last_of('.');
+    if (dot != string::npos && dot > 0)
+        name.erase(dot);
+    string plan_name = name + ".plan";
+    for (int copy = 2; !taken.insert(plan_name).second; copy++)
+        plan_name = name + "-" + to_string(copy) + ".plan";
+    return plan_name;
+}
+
+bool runBatchPlanning(DeliveryPlanner& planner, const vector<string>& paths, const string& outputDir,
+                      ostream& report)
+{
+    if (mkdir(outputDir.c_str(), 0777) != 0 && errno != EEXIST)
+        return false;
+    vector<string> files;
+    for (const string& path : paths)
+        addDeliveriesFiles(path, files);
+
+    // read every manifest up front, so planning isn't held up by the disk
+    vector<string> names;
+    vector<DeliveryManifest> manifests;
+    set<string> taken;
+    for (const string& file : files)
+    {
+        DeliveryManifest manifest;
+        if (!loadDeliveryRequests(file, manifest.depot, manifest.deliveries))
+        {
+            report << "Unable to load delivery request file " << file << endl;
+            continue;
+        }
+        names.push_back(planName(file, taken));
+        manifests.push_back(manifest);
+    }
+    if (manifests.empty())
+        return false;
+
+    // a depot's tree costs as much as routing a handful of legs, and only
+    // saves two legs a manifest, so it's built for depots that are shared
+    map<GeoCoord, int> depot_uses;
+    for (const DeliveryManifest& manifest : manifests)
+        if (++depot_uses[manifest.depot] == 2)
+            planner.AddDepot(manifest.depot);
+
+    vector<ManifestPlan> plans;
+    auto start = chrono::steady_clock::now();
+    planner.GenerateDeliveryPlans(manifests, plans);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    size_t num_deliveries = 0;
+    int num_failed = 0;
+    report << fixed << setprecision(2);
+    for (size_t i = 0; i < manifests.size(); i++)
+    {
+        ofstream out(outputDir + "/" + names[i]);
+        writeDeliveryPlan(out, plans[i].result, plans[i].commands, plans[i].totalDistance);
+        num_deliveries += manifests[i].deliveries.size();
+        report << names[i] << ": " << manifests[i].deliveries.size() << " deliveries, ";
+        if (plans[i].result == DELIVERY_SUCCESS)
+            report << plans[i].totalDistance << " miles";
+        else
+        {
+            report << (plans[i].result == BAD_COORD ? "bad coordinates" : "no route");
+            num_failed++;
+        }
+        if (!out)
+            report << ", unable to write " << outputDir << "/" << names[i];
+        report << ", " << plans[i].elapsedMs << " ms" << endl;
+    }
+    report << "Planned " << manifests.size() << " manifests (" << num_deliveries << " deliveries, "
+           << num_failed << " failed) in " << seconds << " s: " << manifests.size() / seconds
+           << " manifests/s, " << num_deliveries / seconds << " deliveries/s" << endl;
+    return true;
+}
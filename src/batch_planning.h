@@ -0,0 +1,25 @@
+//  Author:  Noah Himed
+//  Date:    16 October 2026
+//  Summary: Plans a batch of deliveries files against one loaded map,
+//           writing each plan to a file of its own.
+
+#ifndef BATCH_PLANNING_INCLUDED
+#define BATCH_PLANNING_INCLUDED
+
+#include "provided.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Plans every deliveries file named in paths with planner, taking each
+// directory among them to mean every file in it. The plan for deliveries.txt is written to
+// deliveries.plan in outputDir, which is created if need be, as
+// delivery_navigator would print it. How long each manifest took, and the
+// batch's throughput, are reported to report. Depots that more than one
+// manifest starts from are added to planner first. Returns false if
+// outputDir can't be made or there were no manifests to plan.
+bool runBatchPlanning(DeliveryPlanner& planner, const std::vector<std::string>& paths, const std::string& outputDir,
+                      std::ostream& report);
+
+#endif // BATCH_PLANNING_INCLUDED
@@ -0,0 +1,46 @@
+//  Author:  Noah Himed
+//  Date:    16 October 2026
+//  Summary: Offline step that converts a text map data file into the
+//           compiled binary map format loaded by StreetMap::load, and
+//           optionally preprocesses its contraction hierarchy
+
+#include "provided.h"
+
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3 && argc != 4)
+    {
+        cout << "Usage: " << argv[0] << " mapdata.txt mapdata.bin [mapdata.ch]" << endl;
+        return 1;
+    }
+
+    StreetMap sm;
+    if (!sm.load(argv[1]))
+    {
+        cout << "Unable to load map data file " << argv[1] << endl;
+        return 1;
+    }
+    if (!sm.compile(argv[2]))
+    {
+        cout << "Unable to write compiled map file " << argv[2] << endl;
+        return 1;
+    }
+    cout << "Compiled " << argv[1] << " into " << argv[2] << endl;
+
+    if (argc == 4)
+    {
+        ContractionHierarchy ch(&sm);
+        ch.Build();
+        if (!ch.save(argv[3]))
+        {
+            cout << "Unable to write contraction hierarchy file " << argv[3] << endl;
+            return 1;
+        }
+        cout << "Wrote the contraction hierarchy of " << argv[1] << " to " << argv[3] << endl;
+    }
+}
@@ -0,0 +1,548 @@
+//  Author:  Noah Himed
+//  Date:    16 October 2026
+//  Summary: Builds, saves and queries a Contraction Hierarchy over a
+//           StreetMap, unpacking the shortcuts a query follows back into
+//           the map's own edges.
+
+#include "provided.h"
+#include "graph_search.h"
+#include "map_format.h"
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+using namespace std;
+
+// marks an arc that is one of the map's own edges rather than a shortcut
+const uint32_t NO_ARC = 0xFFFFFFFF;
+
+// a contracted node's witness searches give up after settling this many
+// nodes; stopping early only costs an unneeded shortcut, never correctness
+const int WITNESS_SETTLE_LIMIT = 500;
+
+// Layout of a saved hierarchy: the header, then rank[num_nodes],
+// up_offsets[num_nodes + 1], up_arcs[num_up_arcs] and arcs[num_arcs]
+// back to back, written in the host's byte order like a compiled map.
+const char HIERARCHY_MAGIC[8] = {'D', 'N', 'C', 'H', 'B', 'I', 'N', '\0'};
+const uint32_t HIERARCHY_VERSION = 1;
+
+struct HierarchyHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t endian_tag;
+    uint32_t num_nodes;
+    uint32_t num_up_arcs;
+    uint32_t num_arcs;
+    uint32_t padding;
+    uint64_t map_fingerprint;   // StreetMap::Fingerprint of the map it was built from
+    uint64_t checksum;          // mapChecksum of every byte after the header
+};
+
+class ContractionHierarchyImpl
+{
+public:
+    ContractionHierarchyImpl(const StreetMap* sm);
+    ~ContractionHierarchyImpl();
+    void Build();
+    bool IsBuilt() const;
+    bool Save(string hierarchy_path) const;
+    bool Load(string hierarchy_path);
+    DeliveryResult GenerateNodeRoute(
+        NodeId start,
+        NodeId end,
+        vector<EdgeId>& route,
+        double& total_dist_travelled,
+        unsigned long* num_settled) const;
+private:
+    // An undirected connection between two nodes, either one of the map's
+    // edges or a shortcut standing for the arcs child_a (joining source and
+    // middle) followed by child_b (joining middle and target).
+    struct Arc
+    {
+        NodeId source;
+        NodeId target;
+        NodeId middle;
+        uint32_t child_a;
+        uint32_t child_b;
+        EdgeId edge;        // the map edge from source to target, for non-shortcuts
+        double weight;
+    };
+    // an arc as seen from one of its ends
+    struct Neighbor
+    {
+        NodeId node;
+        uint32_t arc;
+        double weight;
+    };
+
+    // adds an arc between two uncontracted nodes unless one at least as
+    // short already joins them
+    void AddArc(vector<vector<Neighbor>>& graph, const Arc& arc);
+    // counts (or with add_shortcuts, adds) the shortcuts needed to keep
+    // distances between node's neighbors once node is gone
+    int ContractNode(vector<vector<Neighbor>>& graph, NodeId node, bool add_shortcuts);
+    // appends the map edges making up arc, traversed starting from the node from
+    void UnpackArc(uint32_t arc, NodeId from, vector<EdgeId>& route) const;
+
+    const StreetMap* m_sm_ptr;
+    // node importance; every query only follows arcs toward higher ranks
+    vector<uint32_t> m_rank;
+    // each node's arcs to higher ranked nodes, in compressed sparse row form
+    vector<uint32_t> m_up_offsets;
+    vector<Neighbor> m_up_arcs;
+    vector<Arc> m_arcs;
+
+    // scratch space for the witness searches run while building
+    vector<double> m_witness_dist;
+    vector<uint32_t> m_witness_stamp;
+    uint32_t m_witness_generation;
+};
+
+ContractionHierarchyImpl::ContractionHierarchyImpl(const StreetMap* sm)
+: m_sm_ptr(sm), m_witness_generation(0)
+{}
+
+ContractionHierarchyImpl::~ContractionHierarchyImpl()
+{}
+
+bool ContractionHierarchyImpl::IsBuilt() const
+{
+    return !m_up_offsets.empty() && m_rank.size() == m_sm_ptr->NodeCount();
+}
+
+void ContractionHierarchyImpl::Build()
+{
+    const NodeId num_nodes = m_sm_ptr->NodeCount();
+    vector<vector<Neighbor>> graph(num_nodes);
+    m_arcs.clear();
+    m_witness_dist.assign(num_nodes, 0.0);
+    m_witness_stamp.assign(num_nodes, 0);
+    m_witness_generation = 0;
+
+    // start from the map's own edges; each segment is stored in both
+    // directions, so only its edge toward the higher id is needed
+    for(NodeId node = 0; node < num_nodes; node++)
+        for(StreetEdge edge : m_sm_ptr->Neighbors(node))
+            if(node < edge.target)
+            {
+                Arc arc = {node, edge.target, NO_NODE, NO_ARC, NO_ARC, edge.id, edge.length};
+                AddArc(graph, arc);
+            }
+
+    // Contract nodes in order of priority: the shortcuts a node needs less
+    // the arcs it removes, plus how many of its neighbors are already gone
+    // so contraction spreads evenly over the map. Priorities are refreshed
+    // lazily when a node reaches the front of the queue.
+    vector<int> deleted_neighbors(num_nodes, 0);
+    auto priority = [&](NodeId node) {
+        return ContractNode(graph, node, false) - int(graph[node].size()) + deleted_neighbors[node];
+    };
+    typedef pair<int, NodeId> QueueEntry;
+    priority_queue<QueueEntry, vector<QueueEntry>, greater<QueueEntry>> queue;
+    for(NodeId node = 0; node < num_nodes; node++)
+        queue.emplace(priority(node), node);
+
+    m_rank.assign(num_nodes, 0);
+    vector<vector<Neighbor>> up_arcs(num_nodes);
+    uint32_t next_rank = 0;
+    while(!queue.empty())
+    {
+        NodeId node = queue.top().second;
+        queue.pop();
+        int node_priority = priority(node);
+        if(!queue.empty() && node_priority > queue.top().first)
+        {
+            queue.emplace(node_priority, node);
+            continue;
+        }
+
+        m_rank[node] = next_rank++;
+        ContractNode(graph, node, true);
+        // every remaining neighbor is contracted later, so each of the
+        // node's arcs leads upward
+        up_arcs[node] = graph[node];
+        for(const Neighbor& neighbor : graph[node])
+        {
+            vector<Neighbor>& adjacent = graph[neighbor.node];
+            for(size_t i = 0; i < adjacent.size(); i++)
+                if(adjacent[i].node == node)
+                {
+                    adjacent[i] = adjacent.back();
+                    adjacent.pop_back();
+                    break;
+                }
+            deleted_neighbors[neighbor.node]++;
+        }
+        vector<Neighbor>().swap(graph[node]);
+    }
+
+    m_up_offsets.assign(1, 0);
+    m_up_arcs.clear();
+    for(NodeId node = 0; node < num_nodes; node++)
+    {
+        m_up_arcs.insert(m_up_arcs.end(), up_arcs[node].begin(), up_arcs[node].end());
+        m_up_offsets.push_back(uint32_t(m_up_arcs.size()));
+    }
+    vector<double>().swap(m_witness_dist);
+    vector<uint32_t>().swap(m_witness_stamp);
+}
+
+void ContractionHierarchyImpl::AddArc(vector<vector<Neighbor>>& graph, const Arc& arc)
+{
+    vector<Neighbor>& from_source = graph[arc.source];
+    for(Neighbor& neighbor : from_source)
+        if(neighbor.node == arc.target)
+        {
+            if(neighbor.weight <= arc.weight)
+                return;
+            // replace the longer arc in both end points' lists
+            m_arcs.push_back(arc);
+            uint32_t arc_id = uint32_t(m_arcs.size() - 1);
+            neighbor.arc = arc_id;
+            neighbor.weight = arc.weight;
+            for(Neighbor& back : graph[arc.target])
+                if(back.node == arc.source)
+                {
+                    back.arc = arc_id;
+                    back.weight = arc.weight;
+                }
+            return;
+        }
+
+    m_arcs.push_back(arc);
+    uint32_t arc_id = uint32_t(m_arcs.size() - 1);
+    Neighbor to_target = {arc.target, arc_id, arc.weight}, to_source = {arc.source, arc_id, arc.weight};
+    from_source.push_back(to_target);
+    graph[arc.target].push_back(to_source);
+}
+
+int ContractionHierarchyImpl::ContractNode(vector<vector<Neighbor>>& graph, NodeId node, bool add_shortcuts)
+{
+    // copied, since adding shortcuts may reallocate the neighbor lists
+    const vector<Neighbor> neighbors = graph[node];
+    double max_weight = 0;
+    for(const Neighbor& neighbor : neighbors)
+        max_weight = max(max_weight, neighbor.weight);
+
+    int num_shortcuts = 0;
+    typedef pair<double, NodeId> QueueEntry;
+    vector<QueueEntry> queue;
+    for(size_t i = 0; i < neighbors.size(); i++)
+    {
+        // Dijkstra from this neighbor around node, far enough to tell whether
+        // any later neighbor can be reached without passing through node
+        const NodeId source = neighbors[i].node;
+        const double limit = neighbors[i].weight + max_weight;
+        if(++m_witness_generation == 0)
+        {
+            fill(m_witness_stamp.begin(), m_witness_stamp.end(), 0);
+            m_witness_generation = 1;
+        }
+        auto reached = [this](NodeId n) { return m_witness_stamp[n] == m_witness_generation; };
+        queue.clear();
+        m_witness_dist[source] = 0;
+        m_witness_stamp[source] = m_witness_generation;
+        queue.emplace_back(0.0, source);
+        int num_settled = 0;
+        while(!queue.empty() && num_settled < WITNESS_SETTLE_LIMIT)
+        {
+            pop_heap(queue.begin(), queue.end(), greater<QueueEntry>());
+            QueueEntry top = queue.back();
+            queue.pop_back();
+            if(top.first > m_witness_dist[top.second])
+                continue;
+            if(top.first > limit)
+                break;
+            num_settled++;
+            for(const Neighbor& next : graph[top.second])
+            {
+                if(next.node == node)
+                    continue;
+                double dist = top.first + next.weight;
+                if(!reached(next.node) || dist < m_witness_dist[next.node])
+                {
+                    m_witness_dist[next.node] = dist;
+                    m_witness_stamp[next.node] = m_witness_generation;
+                    queue.emplace_back(dist, next.node);
+                    push_heap(queue.begin(), queue.end(), greater<QueueEntry>());
+                }
+            }
+        }
+
+        for(size_t j = i + 1; j < neighbors.size(); j++)
+        {
+            const NodeId target = neighbors[j].node;
+            const double via_node = neighbors[i].weight + neighbors[j].weight;
+            if(target == source || (reached(target) && m_witness_dist[target] <= via_node))
+                continue;
+            num_shortcuts++;
+            if(add_shortcuts)
+            {
+                Arc shortcut = {source, target, node, neighbors[i].arc, neighbors[j].arc, NO_EDGE, via_node};
+                AddArc(graph, shortcut);
+            }
+        }
+    }
+    return num_shortcuts;
+}
+
+DeliveryResult ContractionHierarchyImpl::GenerateNodeRoute(
+        NodeId start,
+        NodeId end,
+        vector<EdgeId>& route,
+        double& total_dist_travelled,
+        unsigned long* num_settled) const
+{
+    route.clear();
+    total_dist_travelled = 0.0;
+    const NodeId num_nodes = NodeId(m_rank.size());
+    if(!IsBuilt() || start >= num_nodes || end >= num_nodes)
+        return BAD_COORD;
+
+    // Dijkstra upward from both ends at once. The shortest route climbs to
+    // its highest ranked node and comes back down, so the two searches meet
+    // there; a side stops once its smallest key can't beat the best meeting.
+    SearchSpace* searches[2] = {&threadSearchSpace(0), &threadSearchSpace(1)};
+    NodeId roots[2] = {start, end};
+    for(int side = 0; side < 2; side++)
+    {
+        searches[side]->Reset(num_nodes);
+        searches[side]->Update(roots[side], 0, NO_NODE, NO_ARC);
+        searches[side]->Push(roots[side], 0);
+    }
+
+    double best_len = numeric_limits<double>::infinity();
+    NodeId meeting_node = NO_NODE;
+    unsigned long settled = 0;
+    bool done[2] = {false, false};
+    while(!done[0] || !done[1])
+    {
+        for(int side = 0; side < 2; side++)
+            done[side] = searches[side]->QueueEmpty() || searches[side]->TopRank() >= best_len;
+        if(done[0] && done[1])
+            break;
+        int side = done[0] ? 1 : (done[1] ? 0 : (searches[0]->TopRank() <= searches[1]->TopRank() ? 0 : 1));
+        SearchSpace& search = *searches[side];
+        SearchSpace& other = *searches[1 - side];
+
+        NodeId node = search.PopMin();
+        if(search.Settled(node))
+            continue;
+        search.Settle(node);
+        settled++;
+        if(other.Reached(node) && search.Cost(node) + other.Cost(node) < best_len)
+        {
+            best_len = search.Cost(node) + other.Cost(node);
+            meeting_node = node;
+        }
+
+        for(uint32_t i = m_up_offsets[node]; i != m_up_offsets[node + 1]; i++)
+        {
+            const Neighbor& up = m_up_arcs[i];
+            double cost = search.Cost(node) + up.weight;
+            if(!search.Reached(up.node) || cost < search.Cost(up.node))
+            {
+                search.Update(up.node, cost, node, up.arc);
+                search.Push(up.node, cost);
+                if(other.Reached(up.node) && cost + other.Cost(up.node) < best_len)
+                {
+                    best_len = cost + other.Cost(up.node);
+                    meeting_node = up.node;
+                }
+            }
+        }
+    }
+    if(num_settled != nullptr)
+        *num_settled = settled;
+    if(meeting_node == NO_NODE)
+        return NO_ROUTE;
+
+    // gather the arcs from the start up to the meeting node, then unpack them
+    // along with the arcs from the meeting node back down to the end
+    vector<pair<NodeId, uint32_t>> climb;
+    for(NodeId node = meeting_node; node != start; node = searches[0]->Parent(node))
+        climb.emplace_back(searches[0]->Parent(node), searches[0]->ParentEdge(node));
+    for(auto step = climb.rbegin(); step != climb.rend(); step++)
+        UnpackArc(step->second, step->first, route);
+    for(NodeId node = meeting_node; node != end; node = searches[1]->Parent(node))
+        UnpackArc(searches[1]->ParentEdge(node), node, route);
+
+    // sum the edges in order, so the distance matches the other algorithms'
+    for(EdgeId edge : route)
+        total_dist_travelled += m_sm_ptr->EdgeLength(edge);
+    return DELIVERY_SUCCESS;
+}
+
+void ContractionHierarchyImpl::UnpackArc(uint32_t arc_id, NodeId from, vector<EdgeId>& route) const
+{
+    const Arc& arc = m_arcs[arc_id];
+    if(arc.child_a == NO_ARC)
+    {
+        route.push_back(from == arc.source ? arc.edge : reverseEdge(*m_sm_ptr, arc.source, arc.edge));
+        return;
+    }
+    if(from == arc.source)
+    {
+        UnpackArc(arc.child_a, arc.source, route);
+        UnpackArc(arc.child_b, arc.middle, route);
+    }
+    else
+    {
+        UnpackArc(arc.child_b, arc.target, route);
+        UnpackArc(arc.child_a, arc.middle, route);
+    }
+}
+
+bool ContractionHierarchyImpl::Save(string hierarchy_path) const
+{
+    if(!IsBuilt())
+        return false;
+
+    string payload;
+    auto append = [&payload](const void* data, size_t num_bytes) {
+        payload.append(static_cast<const char*>(data), num_bytes);
+    };
+    append(m_rank.data(), m_rank.size()*sizeof(uint32_t));
+    append(m_up_offsets.data(), m_up_offsets.size()*sizeof(uint32_t));
+    append(m_up_arcs.data(), m_up_arcs.size()*sizeof(Neighbor));
+    append(m_arcs.data(), m_arcs.size()*sizeof(Arc));
+
+    HierarchyHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, HIERARCHY_MAGIC, sizeof(header.magic));
+    header.version = HIERARCHY_VERSION;
+    header.endian_tag = COMPILED_MAP_ENDIAN_TAG;
+    header.num_nodes = uint32_t(m_rank.size());
+    header.num_up_arcs = uint32_t(m_up_arcs.size());
+    header.num_arcs = uint32_t(m_arcs.size());
+    header.map_fingerprint = m_sm_ptr->Fingerprint();
+    header.checksum = mapChecksum(payload.data(), payload.size());
+
+    ofstream hierarchy_file(hierarchy_path, ios::binary | ios::trunc);
+    if(!hierarchy_file)
+        return false;
+    hierarchy_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    hierarchy_file.write(payload.data(), payload.size());
+    return bool(hierarchy_file);
+}
+
+bool ContractionHierarchyImpl::Load(string hierarchy_path)
+{
+    ifstream hierarchy_file(hierarchy_path, ios::binary);
+    if(!hierarchy_file)
+        return false;
+    string contents((istreambuf_iterator<char>(hierarchy_file)), istreambuf_iterator<char>());
+
+    HierarchyHeader header;
+    if(contents.size() < sizeof(header))
+        return false;
+    memcpy(&header, contents.data(), sizeof(header));
+    const uint64_t expected_size = sizeof(header) + uint64_t(header.num_nodes)*sizeof(uint32_t)
+        + (uint64_t(header.num_nodes) + 1)*sizeof(uint32_t)
+        + uint64_t(header.num_up_arcs)*sizeof(Neighbor) + uint64_t(header.num_arcs)*sizeof(Arc);
+    if(memcmp(header.magic, HIERARCHY_MAGIC, sizeof(header.magic)) != 0
+       || header.version != HIERARCHY_VERSION
+       || header.endian_tag != COMPILED_MAP_ENDIAN_TAG
+       || header.num_nodes != m_sm_ptr->NodeCount()
+       || header.map_fingerprint != m_sm_ptr->Fingerprint()
+       || contents.size() != expected_size
+       || mapChecksum(contents.data() + sizeof(header), contents.size() - sizeof(header)) != header.checksum)
+        return false;
+
+    const char* pos = contents.data() + sizeof(header);
+    auto read = [&pos](void* data, size_t num_bytes) {
+        memcpy(data, pos, num_bytes);
+        pos += num_bytes;
+    };
+    vector<uint32_t> rank(header.num_nodes);
+    vector<uint32_t> up_offsets(size_t(header.num_nodes) + 1);
+    vector<Neighbor> up_arcs(header.num_up_arcs);
+    vector<Arc> arcs(header.num_arcs);
+    read(rank.data(), rank.size()*sizeof(uint32_t));
+    read(up_offsets.data(), up_offsets.size()*sizeof(uint32_t));
+    read(up_arcs.data(), up_arcs.size()*sizeof(Neighbor));
+    read(arcs.data(), arcs.size()*sizeof(Arc));
+
+    // check every offset, node and arc is in range before taking any of
+    // them; a shortcut's children always come before it, so unpacking one
+    // can't loop, and a plain arc's edge must leave its source
+    const NodeId num_nodes = header.num_nodes;
+    if(up_offsets[0] != 0 || up_offsets.back() != header.num_up_arcs)
+        return false;
+    for(NodeId node = 0; node < num_nodes; node++)
+        if(rank[node] >= num_nodes || up_offsets[node] > up_offsets[node + 1])
+            return false;
+    for(const Neighbor& neighbor : up_arcs)
+        if(neighbor.node >= num_nodes || neighbor.arc >= header.num_arcs)
+            return false;
+    for(uint32_t i = 0; i < header.num_arcs; i++)
+    {
+        const Arc& arc = arcs[i];
+        if(arc.source >= num_nodes || arc.target >= num_nodes)
+            return false;
+        if(arc.child_a != NO_ARC)
+        {
+            if(arc.middle >= num_nodes || arc.child_a >= i || arc.child_b >= i)
+                return false;
+            continue;
+        }
+        bool leaves_source = false;
+        for(StreetEdge edge : m_sm_ptr->Neighbors(arc.source))
+            leaves_source = leaves_source || (edge.id == arc.edge && edge.target == arc.target);
+        if(!leaves_source)
+            return false;
+    }
+
+    m_rank.swap(rank);
+    m_up_offsets.swap(up_offsets);
+    m_up_arcs.swap(up_arcs);
+    m_arcs.swap(arcs);
+    return true;
+}
+
+ContractionHierarchy::ContractionHierarchy(const StreetMap* sm)
+{
+    m_impl = new ContractionHierarchyImpl(sm);
+}
+
+ContractionHierarchy::~ContractionHierarchy()
+{
+    delete m_impl;
+}
+
+void ContractionHierarchy::Build()
+{
+    m_impl->Build();
+}
+
+bool ContractionHierarchy::IsBuilt() const
+{
+    return m_impl->IsBuilt();
+}
+
+bool ContractionHierarchy::save(string hierarchy_path) const
+{
+    return m_impl->Save(hierarchy_path);
+}
+
+bool ContractionHierarchy::load(string hierarchy_path)
+{
+    return m_impl->Load(hierarchy_path);
+}
+
+DeliveryResult ContractionHierarchy::GenerateNodeRoute(
+        NodeId start,
+        NodeId end,
+        vector<EdgeId>& route,
+        double& total_dist_travelled,
+        unsigned long* num_settled) const
+{
+    return m_impl->GenerateNodeRoute(start, end, route, total_dist_travelled, num_settled);
+}
@@ -0,0 +1,105 @@
+//  Author:  Noah Himed
+//  Date:    16 October 2026
+//  Summary: Reads delivery requests in the format of deliveries.txt and
+//           writes plans.
+
+#include "delivery_io.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+bool readDeliveryRequests(istream& in, GeoCoord& depot, vector<DeliveryRequest>& v, ostream& warnings)
+{
+    string lat;
+    string lon;
+    string line;
+    if (!getline(in, line))
+        return false;
+    istringstream depot_line(line);
+    if (!(depot_line >> lat >> lon))
+        return false;
+    // GeoCoord parses its text with stod, which throws on anything that
+    // isn't a number
+    try
+    {
+        depot = GeoCoord(lat, lon);
+    }
+    catch (const logic_error&)
+    {
+        return false;
+    }
+    while (getline(in, line))
+    {
+        string item;
+        if (!parseDelivery(line, lat, lon, item, warnings))
+            continue;
+        try
+        {
+            v.push_back(DeliveryRequest(item, GeoCoord(lat, lon)));
+        }
+        catch (const logic_error&)
+        {
+            warnings << "Bad coordinates in deliveries file line: " << line << endl;
+        }
+    }
+    return true;
+}
+
+bool loadDeliveryRequests(string deliveriesFile, GeoCoord& depot, vector<DeliveryRequest>& v)
+{
+    ifstream inf(deliveriesFile);
+    if (!inf)
+        return false;
+    return readDeliveryRequests(inf, depot, v, cout);
+}
+
+bool parseDelivery(string line, string& lat, string& lon, string& item, ostream& warnings)
+{
+    const size_t colon = line.find(':');
+    if (colon == string::npos)
+    {
+        warnings << "Missing colon in deliveries file line: " << line << endl;
+        return false;
+    }
+    istringstream iss(line.substr(0, colon));
+    if (!(iss >> lat >> lon))
+    {
+        warnings << "Bad format in deliveries file line: " << line << endl;
+        return false;
+    }
+    item = line.substr(colon + 1);
+    if (item.empty())
+    {
+        warnings << "Missing item in deliveries file line: " << line << endl;
+        return false;
+    }
+    return true;
+}
+
+void writeDeliveryPlan(ostream& out, DeliveryResult result, const vector<DeliveryCommand>& commands,
+                       double totalMiles)
+{
+    if (result == BAD_COORD)
+    {
+        out << "One or more depot or delivery coordinates are invalid." << endl;
+        return;
+    }
+    if (result == NO_ROUTE)
+    {
+        out << "No route can be found to deliver all items." << endl;
+        return;
+    }
+    out << "Starting at the depot...\n";
+    for (const auto& dc : commands)
+        out << dc.Description() << endl;
+    out << "You are back at the depot and your deliveries are done!\n";
+    ios::fmtflags flags = out.flags();
+    streamsize precision = out.precision(2);
+    out.setf(ios::fixed);
+    out << totalMiles << " miles travelled for all deliveries." << endl;
+    out.flags(flags);
+    out.precision(precision);
+}
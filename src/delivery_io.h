@@ -0,0 +1,34 @@
+//  Author:  Noah Himed
+//  Date:    16 October 2026
+//  Summary: Reads delivery requests in the format of deliveries.txt, from
+//           a file or from any stream, such as a request to the planning
+//           server, and writes out the plans made for them.
+
+#ifndef DELIVERY_IO_INCLUDED
+#define DELIVERY_IO_INCLUDED
+
+#include "provided.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Reads the depot's coordinates from the first line, then one delivery per
+// line as "latitude longitude:item". Lines that can't be read are reported
+// to warnings and skipped. Returns false if the depot can't be read.
+bool readDeliveryRequests(std::istream& in, GeoCoord& depot, std::vector<DeliveryRequest>& v,
+                          std::ostream& warnings);
+
+// the same from a file, reporting bad lines on cout; false if the file
+// can't be opened
+bool loadDeliveryRequests(std::string deliveriesFile, GeoCoord& depot, std::vector<DeliveryRequest>& v);
+
+// splits one delivery line into its coordinates and item
+bool parseDelivery(std::string line, std::string& lat, std::string& lon, std::string& item,
+                   std::ostream& warnings);
+
+// writes a plan as turn-by-turn directions, or why there isn't one
+void writeDeliveryPlan(std::ostream& out, DeliveryResult result, const std::vector<DeliveryCommand>& commands,
+                       double totalMiles);
+
+#endif // DELIVERY_IO_INCLUDED
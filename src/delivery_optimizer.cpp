@@ -5,15 +5,87 @@
 //           the Traveling Salesman problem of ordering deliveries.
 
 #include "provided.h"
+#include "fast_random.h"
+#include "thread_pool.h"
+#include "tour_search.h"
 
 #include <vector>
-#include <iterator>
-#include <ctime>
+#include <algorithm>
 #include <cmath>
 #include <random>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <limits>
+#include <map>
 
 using namespace std;
 
+// How often, in temperatures, a chain running alongside others checks
+// whether another has found a shorter tour and carries on from that one.
+const int ADOPT_INTERVAL = 10;
+
+// the annealing schedule: the first temperature, in miles, and how much
+// of it is kept from one temperature to the next
+const double START_TEMPERATURE = 0.5;
+const double COOLING_RATE = 0.9;
+
+// how many candidate changes are tried between looks at the clock
+const int DEADLINE_CHECK_INTERVAL = 256;
+
+// when an annealing run gives up early
+struct AnnealLimits : SearchDeadline
+{
+    int stall_temperatures;     // 0 for never
+};
+
+// what one annealing chain did
+struct AnnealStats
+{
+    unsigned long long moves_tried;
+    int temperatures;
+    bool hit_deadline;
+    bool stalled;
+};
+
+// The shortest tour found so far by any of several annealing chains. A
+// chain publishes a tour by swapping in a pointer to a copy of it with a
+// compare-and-swap, so publishing and reading never wait on a lock. Copies
+// never change once published, and the chain that made each one keeps it
+// until every chain is done, so a tour read by one chain can't be freed
+// under it by another.
+class SharedBestTour
+{
+public:
+    struct Tour
+    {
+        vector<int> path;
+        double length;
+        int chain;
+    };
+
+    SharedBestTour(int num_chains)
+    : m_best(nullptr), m_published(num_chains)
+    {}
+    // nullptr until the first tour is published
+    const Tour* Best() const { return m_best.load(memory_order_acquire); }
+    // Offers a chain's tour, kept if shorter than the best so far. Ties go
+    // to the lower chain, so which tour wins doesn't depend on timing.
+    void Publish(const vector<int>& path, double length, int chain)
+    {
+        Tour* tour = new Tour{path, length, chain};
+        m_published[chain].emplace_back(tour);
+        const Tour* best = m_best.load(memory_order_acquire);
+        while(best == nullptr || length < best->length || (length == best->length && chain < best->chain))
+            if(m_best.compare_exchange_weak(best, tour, memory_order_acq_rel, memory_order_acquire))
+                break;
+    }
+private:
+    atomic<const Tour*> m_best;
+    // every tour each chain has published, only ever touched by that chain
+    vector<vector<unique_ptr<Tour>>> m_published;
+};
+
 class DeliveryOptimizerImpl
 {
 public:
@@ -25,150 +97,528 @@ public:
     void OptimizeDeliveryOrder(
         const GeoCoord& depot,
         vector<DeliveryRequest>& deliveries,
-        double& old_crow_dist,
-        double& new_crow_dist) const;
+        double& old_dist,
+        double& new_dist,
+        const OptimizerOptions& options,
+        OptimizerReport& report) const;
+    void SetDepotTree(const DepotTree* tree);
 private:
+    // sets up costs between the points, measured as options ask; true if
+    // they're road distances, false if they fell back on straight lines
+    bool ComputeCosts(const vector<GeoCoord>& points, const OptimizerOptions& options,
+                      TourCosts& costs) const;
+    // improves the order of path, a tour from path.front() back to
+    // path.back() whose ends stay put, by simulated annealing; a chain
+    // running alongside others publishes its best tours to shared, and
+    // unless adopt is false takes up shorter tours others have published
+    void Anneal(const TourCosts& costs, vector<int>& path, FastRandom& rng,
+                const AnnealLimits& limits, AnnealStats& stats,
+                SharedBestTour* shared = nullptr, int chain = 0, bool adopt = false) const;
+    // improves path by Anneal, in as many chains as options ask for,
+    // and adds how it went to report
+    void AnnealChains(const TourCosts& costs, vector<int>& path, const OptimizerOptions& options,
+                      const AnnealLimits& limits, OptimizerReport& report) const;
+    // improves path by Lin-Kernighan style moves, and reports how far it
+    // may be from the shortest tour
+    void LinKernighan(const TourCosts& costs, vector<int>& path, const OptimizerOptions& options,
+                      const SearchDeadline& deadline, OptimizerReport& report) const;
+    // replaces path with a tour joined up from tours of clusters of
+    // nearby points, each found separately and all at once
+    void ClusteredSearch(const TourCosts& costs, vector<int>& path, const OptimizerOptions& options,
+                         const SearchDeadline& deadline, OptimizerReport& report) const;
+    // replaces path with a tour built along a Hilbert curve and then
+    // improved by 2-opt and Or-opt moves to a local optimum
+    void LocalSearch(const TourCosts& costs, vector<int>& path, const OptimizerOptions& options,
+                     const SearchDeadline& deadline, OptimizerReport& report) const;
     const StreetMap *m_smPtr;
+    // only set when road distances from the depot are known ahead
+    const DepotTree* m_depot_tree;
 };
 
 DeliveryOptimizerImpl::DeliveryOptimizerImpl(const StreetMap* sm)
 {
     m_smPtr = sm;
+    m_depot_tree = nullptr;
+}
+
+void DeliveryOptimizerImpl::SetDepotTree(const DepotTree* tree)
+{
+    m_depot_tree = tree;
 }
 
 DeliveryOptimizerImpl::~DeliveryOptimizerImpl()
 {}
 
+bool DeliveryOptimizerImpl::ComputeCosts(const vector<GeoCoord>& points, const OptimizerOptions& options,
+                                         TourCosts& costs) const
+{
+    // past MAX_MATRIX_POINTS even a matrix of road distances is too big to
+    // keep, so costs fall back to straight lines worked out as needed
+    const size_t num_points = points.size();
+    if(num_points > MAX_MATRIX_POINTS)
+        return false;
+    vector<double> matrix(num_points*num_points);
+    if(options.costModel == COST_ROAD_DISTANCE)
+    {
+        // points are measured from the nodes the planner will route them
+        // from, snapping any that aren't at one to the nearest street
+        vector<NodeId> nodes(num_points);
+        vector<GeoCoord> node_coords;
+        for(size_t i = 0; i < num_points && m_smPtr->SnapToNode(points[i], nodes[i]); i++)
+            node_coords.push_back(m_smPtr->NodeCoord(nodes[i]));
+        const bool all_placed = (node_coords.size() == num_points);
+
+        // With the depot's tree at hand, point 0's row and column are
+        // lookups, and only the stops need sweeps of their own; point 0 is
+        // the depot, whose sweep has to reach every stop.
+        const bool use_tree = all_placed && m_depot_tree != nullptr && m_depot_tree->IsBuilt()
+            && nodes[0] == m_depot_tree->Root();
+        const size_t first = use_tree ? 1 : 0;
+        DistanceMatrix road_distances(m_smPtr);
+        bool all_reachable = all_placed
+            && (road_distances.Compute(vector<GeoCoord>(node_coords.begin() + first, node_coords.end()))
+                == DELIVERY_SUCCESS);
+        for(size_t i = first; all_reachable && i < num_points; i++)
+            for(size_t j = first; j < num_points; j++)
+            {
+                matrix[i*num_points + j] = road_distances.Distance(int(i - first), int(j - first));
+                if(isinf(matrix[i*num_points + j]))
+                {
+                    all_reachable = false;
+                    break;
+                }
+            }
+        for(size_t j = 1; use_tree && all_reachable && j < num_points; j++)
+        {
+            matrix[j] = matrix[j*num_points] = m_depot_tree->Distance(nodes[j]);
+            all_reachable = !isinf(matrix[j]);
+        }
+        if(all_reachable)
+        {
+            costs.UseMatrix(matrix);
+            return true;
+        }
+    }
+
+    // "crow distance" describes the distance between a set of locations
+    // measured along straight lines, point to point
+    for(size_t i = 0; i < num_points; i++)
+        for(size_t j = i; j < num_points; j++)
+        {
+            matrix[i*num_points + j] = distanceEarthMiles(points[i], points[j]);
+            matrix[j*num_points + i] = matrix[i*num_points + j];
+        }
+    costs.UseMatrix(matrix);
+    return false;
+}
+
 void DeliveryOptimizerImpl::OptimizeDeliveryOrder(
     const GeoCoord& depot,
     vector<DeliveryRequest>& deliveries,
-    double& old_crow_dist,
-    double& new_crow_dist) const
+    double& old_dist,
+    double& new_dist,
+    const OptimizerOptions& options,
+    OptimizerReport& report) const
 {
-    // "crow distance" describes the distance between a set of locations
-    // measured along straight lines, point to point
-    new_crow_dist = 0;
-    old_crow_dist = 0;
+    // the budget covers the whole call, working out costs included
+    const chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+    AnnealLimits limits;
+    limits.has_deadline = (options.timeBudgetMs > 0);
+    limits.start = start_time;
+    limits.deadline = start_time + chrono::duration_cast<chrono::steady_clock::duration>(
+        chrono::duration<double, milli>(options.timeBudgetMs));
+    limits.stall_temperatures = options.stallTemperatures;
+    report = OptimizerReport();
+
+    // Deliveries to the same place make one stop. Places are told apart by
+    // the node each snaps to, as the planner will route them, so geocodes
+    // of one building are one stop; a place off the map keeps its own
+    // coordinates. Point 0 is the depot and point i the i'th distinct place
+    // delivered to; the path is the order the points are visited in, from
+    // the depot back to the depot.
+    vector<GeoCoord> points;
+    points.push_back(depot);
+    vector<int> delivery_points;
+    map<NodeId, int> node_points;
+    map<GeoCoord, int> location_points;
+    for(const DeliveryRequest& request: deliveries)
+    {
+        const int next_point = int(points.size());
+        NodeId node;
+        int point;
+        if(m_smPtr->SnapToNode(request.location, node))
+        {
+            point = node_points.insert(make_pair(node, next_point)).first->second;
+            if(point == next_point)
+                points.push_back(m_smPtr->NodeCoord(node));
+        }
+        else
+        {
+            point = location_points.insert(make_pair(request.location, next_point)).first->second;
+            if(point == next_point)
+                points.push_back(request.location);
+        }
+        delivery_points.push_back(point);
+    }
+    const size_t num_stops = points.size() - 1;
+    report.numStops = int(num_stops);
+    TourCosts costs(points);
+    report.usedRoadDistances = ComputeCosts(points, options, costs);
+    auto path_length = [&](const vector<int>& path) {
+        double length = 0;
+        for(size_t k = 0; k + 1 < path.size(); k++)
+            length += costs(path[k], path[k + 1]);
+        return length;
+    };
     
-    vector<DeliveryRequest> delivery_path;
-    // add depot to delivery path
-    delivery_path.emplace_back("", depot);
-    for(DeliveryRequest request: deliveries)
-        delivery_path.push_back(request);
-    delivery_path.emplace_back("", depot);
+    vector<int> delivery_path;
+    for(size_t i = 0; i < points.size(); i++)
+        delivery_path.push_back(int(i));
+    delivery_path.push_back(0);
     
-    // compute old_crow_dist
-    for(auto delivery_it = delivery_path.begin(); delivery_it != prev(delivery_path.end()); delivery_it++)
-        old_crow_dist += distanceEarthMiles(delivery_it->location, next(delivery_it)->location);
+    // the deliveries in the order given, back to the same place or not
+    vector<int> given_path(1, 0);
+    given_path.insert(given_path.end(), delivery_points.begin(), delivery_points.end());
+    given_path.push_back(0);
+    old_dist = path_length(given_path);
+    if(num_stops > 1 && num_stops <= size_t(min(options.exactThreshold, MAX_EXACT_POINTS)))
+    {
+        delivery_path = solveHeldKarp(costs);
+        report.optimal = true;
+    }
+    else if(num_stops > 1 && options.engine == ENGINE_LOCAL_SEARCH)
+        LocalSearch(costs, delivery_path, options, limits, report);
+    else if(num_stops > 1 && options.engine == ENGINE_LIN_KERNIGHAN)
+    {
+        // polish the annealer's tour; with a time budget, the annealer
+        // has the first half of it
+        AnnealLimits anneal_limits = limits;
+        if(limits.has_deadline)
+            anneal_limits.deadline = limits.start + (limits.deadline - limits.start)/2;
+        AnnealChains(costs, delivery_path, options, anneal_limits, report);
+        LinKernighan(costs, delivery_path, options, limits, report);
+    }
+    else if(num_stops > 1 && options.engine == ENGINE_CLUSTERED)
+        ClusteredSearch(costs, delivery_path, options, limits, report);
+    else if(num_stops > 1)
+        AnnealChains(costs, delivery_path, options, limits, report);
+    new_dist = path_length(delivery_path);
     
+    // drop the depot from the beggning and end, and put the deliveries in
+    // order, those to one place together in the order they were given
+    vector<vector<int>> point_deliveries(points.size());
+    for(size_t i = 0; i < deliveries.size(); i++)
+        point_deliveries[delivery_points[i]].push_back(int(i));
+    vector<DeliveryRequest> ordered_deliveries;
+    for(size_t k = 1; k + 1 < delivery_path.size(); k++)
+        for(int i : point_deliveries[delivery_path[k]])
+            ordered_deliveries.push_back(deliveries[i]);
+    deliveries = ordered_deliveries;
+    report.elapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start_time).count();
+}
+
+void DeliveryOptimizerImpl::AnnealChains(const TourCosts& costs, vector<int>& delivery_path,
+                                         const OptimizerOptions& options, const AnnealLimits& limits,
+                                         OptimizerReport& report) const
+{
+    // seed random number generator, once per run
+    uint64_t seed = options.seed;
+    if(!options.deterministic)
+    {
+        random_device rd;
+        seed = (uint64_t(rd()) << 32) ^ rd();
+    }
+    int num_chains = options.numChains > 0 ? options.numChains : int(ThreadPool::Shared().ThreadCount());
+    vector<AnnealStats> chain_stats(num_chains);
+    if(num_chains == 1)
+    {
+        FastRandom rng(seed);
+        Anneal(costs, delivery_path, rng, limits, chain_stats[0]);
+    }
+    else
+    {
+        // Chain i is seeded with seed + i. Deterministic runs leave the
+        // chains independent, so the tour kept is the same however
+        // their threads are scheduled.
+        SharedBestTour shared(num_chains);
+        parallelFor(size_t(num_chains), [&](size_t chain) {
+            vector<int> path = delivery_path;
+            FastRandom rng(seed + chain);
+            Anneal(costs, path, rng, limits, chain_stats[chain], &shared, int(chain), !options.deterministic);
+        });
+        delivery_path = shared.Best()->path;
+    }
+    for(const AnnealStats& stats : chain_stats)
+    {
+        report.movesTried += stats.moves_tried;
+        report.temperatures = max(report.temperatures, stats.temperatures);
+        report.hitTimeBudget = report.hitTimeBudget || stats.hit_deadline;
+        report.stalled = report.stalled || stats.stalled;
+    }
+}
+
+void DeliveryOptimizerImpl::LinKernighan(const TourCosts& costs, vector<int>& delivery_path,
+                                         const OptimizerOptions& options, const SearchDeadline& deadline,
+                                         OptimizerReport& report) const
+{
+    CandidateLists candidates(costs, options.candidateCount);
+    ArrayTour tour(vector<int>(delivery_path.begin(), delivery_path.end() - 1));
+    report.movesTried += improveLinKernighan(costs, candidates, tour, deadline, report.hitTimeBudget);
+    delivery_path = tour.PathFrom(0);
+
+    double length = 0;
+    for(size_t k = 0; k + 1 < delivery_path.size(); k++)
+        length += costs(delivery_path[k], delivery_path[k + 1]);
+    report.lowerBound = heldKarpBound(costs, length, deadline);
+    if(report.lowerBound > 0)
+        report.gap = max(0.0, (length - report.lowerBound)/report.lowerBound);
+}
+
+void DeliveryOptimizerImpl::LocalSearch(const TourCosts& costs, vector<int>& delivery_path,
+                                        const OptimizerOptions& options, const SearchDeadline& deadline,
+                                        OptimizerReport& report) const
+{
+    // The stops are given in no useful order, so the search starts from the
+    // order a space-filling curve visits them in, which is within about a
+    // quarter of the best tour, rather than spending its moves untangling
+    // the given one.
+    CandidateLists candidates(costs, options.candidateCount);
+    ArrayTour tour(hilbertOrder(costs.Points()));
+    report.movesTried = improveTwoOptOrOpt(costs, candidates, tour, deadline, report.hitTimeBudget);
+    delivery_path = tour.PathFrom(0);
+}
+
+void DeliveryOptimizerImpl::ClusteredSearch(const TourCosts& costs, vector<int>& delivery_path,
+                                            const OptimizerOptions& options, const SearchDeadline& deadline,
+                                            OptimizerReport& report) const
+{
+    // Cut the Hilbert curve through the points into runs of about equal
+    // size. Points near each other along the curve are near each other on
+    // the map, and each run ends near where the next begins.
+    const vector<int> curve = hilbertOrder(costs.Points());
+    const size_t num_clusters = max<size_t>(1, curve.size()/max(1, options.clusterSize));
+    vector<vector<int>> clusters(num_clusters);
+    for(size_t k = 0; k < curve.size(); k++)
+        clusters[k*num_clusters/curve.size()].push_back(curve[k]);
+
+    // Order each cluster by itself, all at once. A cluster's points are
+    // already in curve order, which is where its search starts.
+    vector<unsigned long long> moves_tried(num_clusters);
+    vector<char> hit_deadline(num_clusters);
+    parallelFor(num_clusters, [&](size_t cluster) {
+        TourCosts cluster_costs = costs.Subset(clusters[cluster]);
+        CandidateLists candidates(cluster_costs, options.candidateCount);
+        vector<int> order(clusters[cluster].size());
+        for(size_t k = 0; k < order.size(); k++)
+            order[k] = int(k);
+        ArrayTour tour(order);
+        bool hit = false;
+        moves_tried[cluster] = improveLinKernighan(cluster_costs, candidates, tour, deadline, hit);
+        hit_deadline[cluster] = hit;
+        vector<int> cluster_path = tour.PathFrom(0);
+        cluster_path.pop_back();
+        for(int& point : cluster_path)
+            point = clusters[cluster][point];
+        clusters[cluster].swap(cluster_path);
+    });
+
+    // Join the clusters' tours in curve order. Each tour is opened at the
+    // edge that makes entering it from where the last one was left
+    // cheapest, and followed round whichever way starts at that entry.
+    vector<int> order, seam_points;
+    order.reserve(curve.size());
+    int exit = curve.back();
+    for(const vector<int>& cycle : clusters)
+    {
+        seam_points.push_back(exit);
+        const size_t size = cycle.size();
+        size_t best_edge = 0;
+        bool best_forward = true;
+        double best_change = numeric_limits<double>::infinity();
+        for(size_t k = 0; k < size; k++)
+        {
+            const int from = cycle[k], to = cycle[(k + 1) % size];
+            const double opened = (size > 1) ? costs(from, to) : 0;
+            if(costs(exit, to) - opened < best_change)
+            {
+                best_change = costs(exit, to) - opened;
+                best_edge = k;
+                best_forward = true;
+            }
+            if(costs(exit, from) - opened < best_change)
+            {
+                best_change = costs(exit, from) - opened;
+                best_edge = k;
+                best_forward = false;
+            }
+        }
+        // forward enters at the edge's far end and leaves at its near
+        // end; backward the other way round
+        for(size_t k = 0; k < size; k++)
+            order.push_back(best_forward ? cycle[(best_edge + 1 + k) % size]
+                                         : cycle[(best_edge + size - k) % size]);
+        seam_points.push_back(order[order.size() - size]);
+        exit = order.back();
+    }
+
+    // Polish where the tours were joined, starting from the points either
+    // side of each join and spreading only as far as moves change the
+    // tour. Only improving moves are made, since a tentative Lin-Kernighan
+    // move on the whole tour would cost time in proportion to its length.
+    CandidateLists candidates(costs, options.candidateCount);
+    ArrayTour tour(order);
+    report.movesTried = improveTwoOptOrOpt(costs, candidates, tour, deadline, report.hitTimeBudget, &seam_points);
+    for(size_t cluster = 0; cluster < num_clusters; cluster++)
+    {
+        report.movesTried += moves_tried[cluster];
+        report.hitTimeBudget = report.hitTimeBudget || hit_deadline[cluster];
+    }
+    delivery_path = tour.PathFrom(0);
+}
+
+void DeliveryOptimizerImpl::Anneal(const TourCosts& costs, vector<int>& delivery_path, FastRandom& rng,
+                                   const AnnealLimits& limits, AnnealStats& stats,
+                                   SharedBestTour* shared, int chain, bool adopt) const
+{
     // Ultilize Simmulated Annealing algorithm to optimize delivery order
     // Here, the idea is that random changes are made more frequently in the
     // beginning when the "temperature" (a measure of the time since the algorithm
     // began) is high at start, and less frequently when temperature is low at the end
-    if(deliveries.size() > 1)
+    //
+    // Each candidate change is costed from the handful of edges it replaces
+    // without touching the path, which is only rearranged once a change is
+    // taken, so trying a change costs the same however long the tour is.
+    int max_iterations = 100;
+    int num_stops = int(delivery_path.size()), num_middle_stops = num_stops-2;
+    int max_paths_temp = max_iterations*num_stops, max_paths_before_cont = max_iterations*num_stops, num_passes;
+    double curr_path_len = 0, cost_diff, temperature = START_TEMPERATURE;
+    for(int k = 0; k + 1 < num_stops; k++)
+        curr_path_len += costs(delivery_path[k], delivery_path[k + 1]);
+    vector<int> best_path = delivery_path;
+    double best_path_len = curr_path_len;
+    
+    int num_start_coords, num_end_coords;
+    const int* path = delivery_path.data();
+    stats.moves_tried = 0;
+    stats.temperatures = 0;
+    stats.hit_deadline = false;
+    stats.stalled = false;
+    int num_stalled = 0;
+    
+    // loop through max_iterations number of period with same temperature
+    for(int i = 0; i < max_iterations && !stats.hit_deadline; i++)
     {
-        // seed random number generator
-        srand(unsigned(time(0)));
-        int max_iterations = 100;
-        int num_stops = int(delivery_path.size()), num_middle_stops = num_stops-2;
-        int max_paths_temp = max_iterations*num_stops, max_paths_before_cont = max_iterations*num_stops, num_passes;
-        double new_path_len, curr_path_len = old_crow_dist, cost_diff, temperature = 0.5;
-        
-        int num_start_coords, num_end_coords;
-        vector<DeliveryRequest> temp_path;
-        
-        // loop through max_iterations number of period with same temperature
-        for(int i = 0; i < max_iterations; i++)
+        num_passes = 0;
+        stats.temperatures++;
+        for(int j = 0; j < max_paths_temp; j++)
         {
-            num_passes = 0;
-            for(int j = 0; j < max_paths_temp; j++)
+            // with a time budget, cool at least as fast as the budget is
+            // used up, so a big tour is fully cooled by the deadline rather
+            // than cut off while still hot
+            if(limits.has_deadline && j % DEADLINE_CHECK_INTERVAL == 0)
             {
-                // randomly select a section
-                do
+                chrono::steady_clock::time_point now = chrono::steady_clock::now();
+                if(now >= limits.deadline)
                 {
-                    num_start_coords = (rand() % num_middle_stops) + 1;
-                    num_end_coords = (rand() % num_middle_stops) + 1;
-                    if(num_end_coords == num_middle_stops+1)
-                        num_end_coords--;
-                    if(num_start_coords > num_end_coords)
-                    {
-                        int tempCoord = num_end_coords;
-                        num_end_coords = num_start_coords;
-                        num_start_coords = tempCoord;
-                    }
-                }
-                // number of stops not in section should be >= ~20% number of stops
-                while((num_start_coords == num_end_coords)
-                      || (num_stops-(num_end_coords-num_start_coords)-1) < 0.2*num_stops);
-                
-                // flip the section half the time
-                if(static_cast<int>(rand() % 2) != 0)
-                {
-                    for(int k = 0; k < num_start_coords; k++)
-                        temp_path.push_back(delivery_path[k]);
-                    for(int k = num_end_coords; k >= num_start_coords; k--)
-                        temp_path.push_back(delivery_path[k]);
-                    for(int k = num_end_coords+1; k < num_stops; k++)
-                        temp_path.push_back(delivery_path[k]);
-                }
-                // otherwise, we move the section to somewhere else in the path
-                else
-                {
-                    temp_path = delivery_path;
-                    auto delivery_it = temp_path.begin()+num_start_coords;
-                    for(int k = 0; k < (num_end_coords-num_start_coords)+1; k++)
-                        delivery_it = temp_path.erase(delivery_it);
-                    int new_position = rand() % (num_stops-(num_end_coords-num_start_coords)-2) + 1;
-                    auto insert_it = temp_path.begin()+new_position;
-                    for(int k = 0; k < (num_end_coords-num_start_coords)+1; k++)
-                        temp_path.insert(insert_it+k, *(delivery_path.begin()+num_start_coords+k));
-                }
-                
-                // get length of new path
-                new_path_len = 0;
-                for(auto new_delivery_it = temp_path.begin(); new_delivery_it != prev(temp_path.end()); new_delivery_it++)
-                    new_path_len += distanceEarthMiles(new_delivery_it->location, next(new_delivery_it)->location);
-                
-                cost_diff = new_path_len - curr_path_len;
-                // if new path is shorter, use it
-                if(cost_diff < 0.0)
-                {
-                    delivery_path = temp_path;
-                    curr_path_len = new_path_len;
-                    num_passes++;
-                }
-                // if the new path is longer, use it sometimes under random chance
-                else if(cost_diff > 0.0)
-                {
-                    // seed random number generator
-                    random_device rd;
-                    mt19937 gen(rd());
-                    uniform_real_distribution<> random_num(0.0, 1.0);
-                    // the probability this segment is used decreased with the temperature
-                    if(double(random_num(gen)) < double(exp(-cost_diff/temperature)))
-                    {
-                        delivery_path = temp_path;
-                        curr_path_len = new_path_len;
-                        num_passes++;
-                    }
-                }
-                temp_path.clear();
-                if(num_passes >= max_paths_before_cont)
+                    stats.hit_deadline = true;
                     break;
+                }
+                double budget_used = chrono::duration<double>(now - limits.start).count()
+                    / chrono::duration<double>(limits.deadline - limits.start).count();
+                temperature = min(temperature, START_TEMPERATURE*pow(COOLING_RATE, budget_used*max_iterations));
+            }
+            stats.moves_tried++;
+
+            // randomly select a section
+            do
+            {
+                num_start_coords = int(rng.Below(num_middle_stops)) + 1;
+                num_end_coords = int(rng.Below(num_middle_stops)) + 1;
+                if(num_start_coords > num_end_coords)
+                    swap(num_start_coords, num_end_coords);
+            }
+            // number of stops not in section should be >= ~20% number of stops
+            while((num_start_coords == num_end_coords)
+                  || (num_stops-(num_end_coords-num_start_coords)-1) < 0.2*num_stops);
+            const int section_len = num_end_coords - num_start_coords + 1;
+            const int before = path[num_start_coords - 1], first = path[num_start_coords];
+            const int last = path[num_end_coords], after = path[num_end_coords + 1];
+            
+            // flip the section half the time
+            bool flip = (rng.Next() >> 63) != 0;
+            int new_position = 0;
+            if(flip)
+                cost_diff = costs(before, last) + costs(first, after) - costs(before, first) - costs(last, after);
+            // otherwise, we move the section to somewhere else in the path,
+            // between the stops new_position - 1 and new_position of the
+            // path without it
+            else
+            {
+                new_position = int(rng.Below(num_stops-section_len-1)) + 1;
+                if(new_position == num_start_coords)
+                    continue;
+                int left = (new_position < num_start_coords) ? path[new_position - 1] : path[new_position - 1 + section_len];
+                int right = (new_position < num_start_coords) ? path[new_position] : path[new_position + section_len];
+                cost_diff = costs(before, after) - costs(before, first) - costs(last, after)
+                    + costs(left, first) + costs(last, right) - costs(left, right);
+            }
+            
+            // take shorter paths, and longer ones sometimes under random chance
+            bool accept = (cost_diff < 0.0);
+            // the probability this segment is used decreased with the temperature
+            if(cost_diff > 0.0)
+                accept = rng.Uniform() < exp(-cost_diff/temperature);
+            if(!accept)
+                continue;
+            
+            auto section_begin = delivery_path.begin() + num_start_coords;
+            auto section_end = delivery_path.begin() + num_end_coords + 1;
+            if(flip)
+                reverse(section_begin, section_end);
+            else if(new_position < num_start_coords)
+                rotate(delivery_path.begin() + new_position, section_begin, section_end);
+            else
+                rotate(section_begin, section_end, delivery_path.begin() + new_position + section_len);
+            curr_path_len += cost_diff;
+            num_passes++;
+            if(num_passes >= max_paths_before_cont)
+                break;
+        }
+        temperature *= COOLING_RATE;
+        
+        // resum the length so rounding in the deltas can't build up, and
+        // keep the shortest path seen at the end of any temperature
+        curr_path_len = 0;
+        for(int k = 0; k + 1 < num_stops; k++)
+            curr_path_len += costs(path[k], path[k + 1]);
+        if(curr_path_len < best_path_len)
+        {
+            best_path = delivery_path;
+            best_path_len = curr_path_len;
+            if(shared != nullptr)
+                shared->Publish(best_path, best_path_len, chain);
+            num_stalled = 0;
+        }
+        else if(limits.stall_temperatures > 0 && ++num_stalled >= limits.stall_temperatures)
+        {
+            stats.stalled = true;
+            break;
+        }
+        
+        // now and then, carry on from another chain's tour if it's shorter
+        if(adopt && (i + 1) % ADOPT_INTERVAL == 0)
+        {
+            const SharedBestTour::Tour* best = shared->Best();
+            if(best != nullptr && best->length < curr_path_len)
+            {
+                copy(best->path.begin(), best->path.end(), delivery_path.begin());
+                curr_path_len = best->length;
             }
-            temperature *= 0.9;
         }
     }
-    
-    // compute new crow distance
-    for(auto delivery_it = delivery_path.begin(); delivery_it != prev(delivery_path.end()); delivery_it++)
-        new_crow_dist += distanceEarthMiles(delivery_it->location, next(delivery_it)->location);
-    
-    // remove "delivery orders" standing in for depot at beggning and end
-    delivery_path.erase(delivery_path.begin());
-    delivery_path.pop_back();
-    
-    deliveries = delivery_path;
+    if(shared != nullptr)
+        shared->Publish(best_path, best_path_len, chain);
+    delivery_path = best_path;
 }
 
 // Functions added by Professors Nachenburg and Smallberg for grading purposes
@@ -189,5 +639,33 @@ void DeliveryOptimizer::OptimizeDeliveryOrder(
         double& old_crow_dist,
         double& new_crow_dist) const
 {
-    return m_impl->OptimizeDeliveryOrder(depot, deliveries, old_crow_dist, new_crow_dist);
+    OptimizerReport report;
+    return m_impl->OptimizeDeliveryOrder(depot, deliveries, old_crow_dist, new_crow_dist, OptimizerOptions(), report);
+}
+
+void DeliveryOptimizer::OptimizeDeliveryOrder(
+        const GeoCoord& depot,
+        vector<DeliveryRequest>& deliveries,
+        double& old_dist,
+        double& new_dist,
+        const OptimizerOptions& options) const
+{
+    OptimizerReport report;
+    return m_impl->OptimizeDeliveryOrder(depot, deliveries, old_dist, new_dist, options, report);
+}
+
+void DeliveryOptimizer::OptimizeDeliveryOrder(
+        const GeoCoord& depot,
+        vector<DeliveryRequest>& deliveries,
+        double& old_dist,
+        double& new_dist,
+        const OptimizerOptions& options,
+        OptimizerReport& report) const
+{
+    return m_impl->OptimizeDeliveryOrder(depot, deliveries, old_dist, new_dist, options, report);
+}
+
+void DeliveryOptimizer::SetDepotTree(const DepotTree* tree)
+{
+    m_impl->SetDepotTree(tree);
 }
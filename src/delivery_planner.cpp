@@ -5,15 +5,99 @@
 //           deliveries with minimized distance travelled.
 
 #include "provided.h"
-#include "expandable_hash_map.h"
+#include "graph_search.h"
+#include "thread_pool.h"
 
 #include <vector>
-#include <list>
-#include <iostream>
-#include <iterator>
+#include <string>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <utility>
 
 using namespace std;
 
+// a place this close to a node is delivered to at the node, rather than
+// along a spur too short to show in the directions
+const double MIN_SPUR_MILES = 0.005;
+
+class DeliveryPlanImpl
+{
+public:
+    DeliveryPlanImpl(const StreetMap* sm, RouteCache* route_cache, const DepotTree* depot_tree);
+    ~DeliveryPlanImpl();
+    DeliveryResult Route(const GeoCoord& depot, const vector<DeliveryRequest>& deliveries);
+    DeliveryResult InsertDelivery(const DeliveryRequest& delivery);
+    DeliveryResult RemoveDelivery(const DeliveryRequest& delivery);
+    vector<DeliveryRequest> Deliveries() const;
+    void GetCommands(vector<DeliveryCommand>& commands) const;
+    double TotalDistance() const;
+private:
+    // Where a depot or delivery is: spur_miles along spur_edge from node.
+    // Places off the map's nodes are on a spur from the nearer end of the
+    // segment they snap to, which legs are routed to and from; the driver
+    // goes along the spur and back from there. A place at a node has no
+    // spur, and spur_edge NO_EDGE.
+    struct Placement
+    {
+        NodeId node;
+        EdgeId spur_edge;
+        double spur_miles;
+    };
+    // one delivery made at a stop, and the spur it's made along
+    struct StopDelivery
+    {
+        DeliveryRequest request;
+        EdgeId spur_edge;
+        double spur_miles;
+    };
+    // A place the driver stops, and everything delivered there: first
+    // what's at the node itself, then what's along each spur in order of
+    // distance out, so each spur is driven out and back once.
+    struct Stop
+    {
+        NodeId node;
+        vector<StopDelivery> deliveries;
+    };
+    // the route from one place to the next
+    struct Leg
+    {
+        vector<EdgeId> edges;
+        double distance;
+    };
+    // Place 0 is the depot, place i the i'th stop, and the place after
+    // the last stop the depot again. Leg i runs from place i to place i + 1.
+    NodeId PlaceNode(size_t place) const
+    {
+        return (place == 0 || place > m_stops.size()) ? m_depot : m_stops[place - 1].node;
+    }
+    // routes the leg from one node to another, off the depot's tree when
+    // one end is its root
+    DeliveryResult RouteLeg(NodeId from, NodeId to, Leg& leg) const;
+    // where gc is, as StreetMap::SnapToNode places it; false if it's too
+    // far from any street
+    bool Place(const GeoCoord& gc, Placement& place) const;
+    // adds a delivery to a stop at the node it's placed at, in spur order
+    static void AddToStop(Stop& stop, const DeliveryRequest& delivery, const Placement& place);
+    // the miles driven out along a stop's spurs and back
+    static double SpurDistance(const Stop& stop);
+    // appends a proceed command for driving miles along edge from the node
+    // from, or with back set, the same stretch back toward from
+    void AddSpurCommand(NodeId from, EdgeId edge, double miles, bool back, vector<DeliveryCommand>& commands) const;
+    const StreetMap *m_sm_ptr;
+    PointToPointRouter m_router;
+    const DepotTree* m_depot_tree;
+    bool m_routed;
+    NodeId m_depot;
+    Placement m_depot_place;
+    vector<Stop> m_stops;
+    vector<Leg> m_legs;
+    double m_total_distance;
+};
+
 class DeliveryPlannerImpl
 {
 public:
@@ -24,20 +108,345 @@ public:
         const vector<DeliveryRequest>& deliveries,
         vector<DeliveryCommand>& commands,
         double& total_dist_travelled) const;
+    DeliveryResult GenerateDeliveryPlan(
+        const GeoCoord& depot,
+        const vector<DeliveryRequest>& deliveries,
+        DeliveryPlan& plan) const;
+    void GenerateDeliveryPlans(
+        const vector<DeliveryManifest>& manifests,
+        vector<ManifestPlan>& plans) const;
+    void SetOptimizerOptions(const OptimizerOptions& options);
+    void SetRouteCache(RouteCache* cache);
+    DeliveryResult AddDepot(const GeoCoord& depot);
 private:
-    DeliveryResult AddDelivery(DeliveryResult& delivery_status, list<StreetSegment>& path_buffer,
-                               list<StreetSegment>& total_path, double& new_distance,
-                               PointToPointRouter& path, const GeoCoord& start, const GeoCoord& end,
-                               list<StreetSegment>& route, double& total_dist_travelled) const;
+    // the tree built for the depot at depot, or nullptr if there's none
+    const DepotTree* TreeFor(const GeoCoord& depot) const;
+
     const StreetMap *m_sm_ptr;
+    OptimizerOptions m_optimizer_options;
+    RouteCache* m_route_cache;
+    vector<unique_ptr<DepotTree>> m_depot_trees;
 };
 
-string getProceedDirection(StreetSegment seg);
-double getSegDist(StreetSegment seg);
+// appends the turn-by-turn commands for driving along the given edges,
+// starting from the node start
+void addLegCommands(const StreetMap& sm, NodeId start, const vector<EdgeId>& leg, vector<DeliveryCommand>& commands);
+string getProceedDirection(double angle);
+double getLineAngle(const FixedCoord& start, const FixedCoord& end);
+
+DeliveryPlanImpl::DeliveryPlanImpl(const StreetMap* sm, RouteCache* route_cache, const DepotTree* depot_tree)
+: m_sm_ptr(sm), m_router(sm), m_depot_tree(depot_tree), m_routed(false), m_depot(0), m_total_distance(0)
+{
+    m_router.SetRouteCache(route_cache);
+    m_depot_place = Placement{0, NO_EDGE, 0};
+}
+
+DeliveryPlanImpl::~DeliveryPlanImpl()
+{}
+
+DeliveryResult DeliveryPlanImpl::RouteLeg(NodeId from, NodeId to, Leg& leg) const
+{
+    if(m_depot_tree != nullptr && m_depot_tree->IsBuilt())
+    {
+        if(from == m_depot_tree->Root())
+            return m_depot_tree->RouteFromDepot(to, leg.edges, leg.distance);
+        if(to == m_depot_tree->Root())
+            return m_depot_tree->RouteToDepot(from, leg.edges, leg.distance);
+    }
+    return m_router.GenerateNodeRoute(from, to, leg.edges, leg.distance);
+}
+
+bool DeliveryPlanImpl::Place(const GeoCoord& gc, Placement& place) const
+{
+    place.spur_edge = NO_EDGE;
+    place.spur_miles = 0;
+    if(m_sm_ptr->FindNode(gc, place.node))
+        return true;
+    StreetSnap snap;
+    if(!m_sm_ptr->SnapToStreet(gc, snap) || snap.distance > MAX_SNAP_MILES)
+        return false;
+    const double length = m_sm_ptr->EdgeLength(snap.edge);
+    if(snap.fraction <= 0.5)
+    {
+        place.node = snap.from;
+        place.spur_edge = snap.edge;
+        place.spur_miles = snap.fraction*length;
+    }
+    else
+    {
+        place.node = snap.to;
+        place.spur_edge = reverseEdge(*m_sm_ptr, snap.from, snap.edge);
+        place.spur_miles = (1 - snap.fraction)*length;
+    }
+    if(place.spur_miles < MIN_SPUR_MILES)
+    {
+        place.spur_edge = NO_EDGE;
+        place.spur_miles = 0;
+    }
+    return true;
+}
+
+void DeliveryPlanImpl::AddToStop(Stop& stop, const DeliveryRequest& delivery, const Placement& place)
+{
+    // deliveries at the node sort first, as NO_EDGE is the largest edge id
+    auto spur_order = [](const StopDelivery& lhs, const StopDelivery& rhs) {
+        EdgeId lhs_edge = lhs.spur_edge + 1, rhs_edge = rhs.spur_edge + 1;
+        return lhs_edge < rhs_edge || (lhs_edge == rhs_edge && lhs.spur_miles < rhs.spur_miles);
+    };
+    StopDelivery added = {delivery, place.spur_edge, place.spur_miles};
+    stop.deliveries.insert(upper_bound(stop.deliveries.begin(), stop.deliveries.end(), added, spur_order), added);
+}
+
+double DeliveryPlanImpl::SpurDistance(const Stop& stop)
+{
+    // each spur's deliveries are together, the furthest out last
+    double distance = 0;
+    for(size_t k = 0; k < stop.deliveries.size(); k++)
+        if(stop.deliveries[k].spur_edge != NO_EDGE
+           && (k + 1 == stop.deliveries.size() || stop.deliveries[k + 1].spur_edge != stop.deliveries[k].spur_edge))
+            distance += 2*stop.deliveries[k].spur_miles;
+    return distance;
+}
+
+DeliveryResult DeliveryPlanImpl::Route(const GeoCoord& depot, const vector<DeliveryRequest>& deliveries)
+{
+    // place every stop on the map once, snapping any that aren't at a node
+    // to the nearest street; from here on legs run between node ids
+    Placement depot_place;
+    if(!Place(depot, depot_place))
+        return BAD_COORD;
+    const NodeId depot_node = depot_place.node;
+    vector<Stop> stops;
+    for(const DeliveryRequest& delivery : deliveries)
+    {
+        Placement place;
+        if(!Place(delivery.location, place))
+            return BAD_COORD;
+        if(stops.empty() || place.node != stops.back().node)
+            stops.push_back(Stop{place.node, vector<StopDelivery>()});
+        AddToStop(stops.back(), delivery, place);
+    }
+    
+    // generate a route between all consecutive places; the legs don't depend
+    // on one another, so they're routed in parallel and then taken in order
+    auto place_node = [&](size_t place) {
+        return (place == 0 || place > stops.size()) ? depot_node : stops[place - 1].node;
+    };
+    vector<Leg> legs(stops.size() + 1);
+    vector<DeliveryResult> leg_statuses(legs.size());
+    parallelFor(legs.size(), [&](size_t i) {
+        leg_statuses[i] = RouteLeg(place_node(i), place_node(i + 1), legs[i]);
+    });
+    // spurs are driven out and back whatever the order, so they add the
+    // same to any tour
+    double total_distance = 2*depot_place.spur_miles;
+    for(const Stop& stop : stops)
+        total_distance += SpurDistance(stop);
+    for(size_t i = 0; i < legs.size(); i++)
+    {
+        if(leg_statuses[i] != DELIVERY_SUCCESS)
+            return leg_statuses[i];
+        total_distance += legs[i].distance;
+    }
+    
+    m_routed = true;
+    m_depot = depot_node;
+    m_depot_place = depot_place;
+    m_stops.swap(stops);
+    m_legs.swap(legs);
+    m_total_distance = total_distance;
+    return DELIVERY_SUCCESS;
+}
+
+DeliveryResult DeliveryPlanImpl::InsertDelivery(const DeliveryRequest& delivery)
+{
+    Placement place;
+    if(!m_routed || !Place(delivery.location, place))
+        return BAD_COORD;
+    const NodeId node = place.node;
+    for(Stop& stop : m_stops)
+        if(stop.node == node)
+        {
+            m_total_distance -= SpurDistance(stop);
+            AddToStop(stop, delivery, place);
+            m_total_distance += SpurDistance(stop);
+            return DELIVERY_SUCCESS;
+        }
+    
+    // Cheapest insertion, by straight lines: the leg the stop lengthens
+    // least when driven through it. Judging by road distance would take a
+    // route search for every leg.
+    const FixedCoord at = m_sm_ptr->NodeFixedCoord(node);
+    size_t best_leg = 0;
+    double best_added = 0;
+    for(size_t i = 0; i < m_legs.size(); i++)
+    {
+        const FixedCoord from = m_sm_ptr->NodeFixedCoord(PlaceNode(i));
+        const FixedCoord to = m_sm_ptr->NodeFixedCoord(PlaceNode(i + 1));
+        double added = distanceEarthMiles(from, at) + distanceEarthMiles(at, to) - distanceEarthMiles(from, to);
+        if(i == 0 || added < best_added)
+        {
+            best_leg = i;
+            best_added = added;
+        }
+    }
+    
+    Leg leg_to, leg_from;
+    DeliveryResult result = RouteLeg(PlaceNode(best_leg), node, leg_to);
+    if(result == DELIVERY_SUCCESS)
+        result = RouteLeg(node, PlaceNode(best_leg + 1), leg_from);
+    if(result != DELIVERY_SUCCESS)
+        return result;
+    
+    Stop stop = {node, vector<StopDelivery>()};
+    AddToStop(stop, delivery, place);
+    m_total_distance += leg_to.distance + leg_from.distance - m_legs[best_leg].distance + SpurDistance(stop);
+    m_stops.insert(m_stops.begin() + best_leg, move(stop));
+    m_legs[best_leg] = move(leg_to);
+    m_legs.insert(m_legs.begin() + best_leg + 1, move(leg_from));
+    return DELIVERY_SUCCESS;
+}
+
+DeliveryResult DeliveryPlanImpl::RemoveDelivery(const DeliveryRequest& delivery)
+{
+    for(size_t s = 0; s < m_stops.size(); s++)
+    {
+        vector<StopDelivery>& deliveries = m_stops[s].deliveries;
+        for(size_t k = 0; k < deliveries.size(); k++)
+        {
+            const DeliveryRequest& request = deliveries[k].request;
+            if(request.item != delivery.item || request.location != delivery.location)
+                continue;
+            if(deliveries.size() > 1)
+            {
+                m_total_distance -= SpurDistance(m_stops[s]);
+                deliveries.erase(deliveries.begin() + k);
+                m_total_distance += SpurDistance(m_stops[s]);
+                return DELIVERY_SUCCESS;
+            }
+            
+            // the stop is place s + 1, so legs s and s + 1 run into and
+            // out of it; one leg from place s to place s + 2 replaces both
+            Leg joined;
+            DeliveryResult result = RouteLeg(PlaceNode(s), PlaceNode(s + 2), joined);
+            if(result != DELIVERY_SUCCESS)
+                return result;
+            m_total_distance += joined.distance - m_legs[s].distance - m_legs[s + 1].distance
+                - SpurDistance(m_stops[s]);
+            m_legs[s] = move(joined);
+            m_legs.erase(m_legs.begin() + s + 1);
+            m_stops.erase(m_stops.begin() + s);
+            return DELIVERY_SUCCESS;
+        }
+    }
+    return BAD_COORD;
+}
+
+vector<DeliveryRequest> DeliveryPlanImpl::Deliveries() const
+{
+    vector<DeliveryRequest> deliveries;
+    for(const Stop& stop : m_stops)
+        for(const StopDelivery& delivery : stop.deliveries)
+            deliveries.push_back(delivery.request);
+    return deliveries;
+}
+
+void DeliveryPlanImpl::GetCommands(vector<DeliveryCommand>& commands) const
+{
+    // generate commands, delivering each stop's items once its leg has been
+    // driven, and driving out along the spurs of any places off the nodes
+    commands.clear();
+    DeliveryCommand next_command;
+    if(m_depot_place.spur_edge != NO_EDGE)
+        AddSpurCommand(m_depot, m_depot_place.spur_edge, m_depot_place.spur_miles, true, commands);
+    for(size_t i = 0; i < m_legs.size(); i++)
+    {
+        addLegCommands(*m_sm_ptr, PlaceNode(i), m_legs[i].edges, commands);
+        // the last leg is back to the depot
+        if(i == m_stops.size())
+            break;
+        const vector<StopDelivery>& deliveries = m_stops[i].deliveries;
+        double out = 0;
+        for(size_t k = 0; k < deliveries.size(); k++)
+        {
+            const StopDelivery& delivery = deliveries[k];
+            if(delivery.spur_miles > out)
+            {
+                AddSpurCommand(m_stops[i].node, delivery.spur_edge, delivery.spur_miles - out, false, commands);
+                out = delivery.spur_miles;
+            }
+            next_command.InitAsDeliverCommand(delivery.request.item);
+            commands.push_back(next_command);
+            // back to the node at the end of each spur
+            if(delivery.spur_edge != NO_EDGE
+               && (k + 1 == deliveries.size() || deliveries[k + 1].spur_edge != delivery.spur_edge))
+            {
+                AddSpurCommand(m_stops[i].node, delivery.spur_edge, out, true, commands);
+                out = 0;
+            }
+        }
+    }
+    if(m_depot_place.spur_edge != NO_EDGE)
+        AddSpurCommand(m_depot, m_depot_place.spur_edge, m_depot_place.spur_miles, false, commands);
+}
+
+void DeliveryPlanImpl::AddSpurCommand(NodeId from, EdgeId edge, double miles, bool back,
+                                      vector<DeliveryCommand>& commands) const
+{
+    FixedCoord start = m_sm_ptr->NodeFixedCoord(from), end = m_sm_ptr->NodeFixedCoord(m_sm_ptr->EdgeTarget(edge));
+    if(back)
+        swap(start, end);
+    double angle = rad2deg(getLineAngle(start, end));
+    if(angle < 0)
+        angle += 360;
+    DeliveryCommand command;
+    command.InitAsProceedCommand(getProceedDirection(angle), m_sm_ptr->StreetName(m_sm_ptr->EdgeStreet(edge)), miles);
+    commands.push_back(command);
+}
+
+double DeliveryPlanImpl::TotalDistance() const
+{
+    return m_total_distance;
+}
 
 DeliveryPlannerImpl::DeliveryPlannerImpl(const StreetMap* sm)
 {
     m_sm_ptr = sm;
+    m_route_cache = nullptr;
+    // order stops by the road distances the legs will actually be driven along
+    m_optimizer_options.costModel = COST_ROAD_DISTANCE;
+}
+
+void DeliveryPlannerImpl::SetOptimizerOptions(const OptimizerOptions& options)
+{
+    m_optimizer_options = options;
+}
+
+void DeliveryPlannerImpl::SetRouteCache(RouteCache* cache)
+{
+    m_route_cache = cache;
+}
+
+DeliveryResult DeliveryPlannerImpl::AddDepot(const GeoCoord& depot)
+{
+    if(TreeFor(depot) != nullptr)
+        return DELIVERY_SUCCESS;
+    unique_ptr<DepotTree> tree(new DepotTree(m_sm_ptr));
+    DeliveryResult result = tree->Build(depot);
+    if(result == DELIVERY_SUCCESS)
+        m_depot_trees.push_back(move(tree));
+    return result;
+}
+
+const DepotTree* DeliveryPlannerImpl::TreeFor(const GeoCoord& depot) const
+{
+    NodeId node;
+    if(m_depot_trees.empty() || !m_sm_ptr->SnapToNode(depot, node))
+        return nullptr;
+    for(const unique_ptr<DepotTree>& tree : m_depot_trees)
+        if(tree->Root() == node)
+            return tree.get();
+    return nullptr;
 }
 
 DeliveryPlannerImpl::~DeliveryPlannerImpl()
@@ -49,136 +458,142 @@ DeliveryResult DeliveryPlannerImpl::GenerateDeliveryPlan(
     vector<DeliveryCommand>& commands,
     double& total_dist_travelled) const
 {
-    // use delivery optimizer to reorder deliveries
+    commands.clear();
+    total_dist_travelled = 0;
+    DeliveryPlan plan(m_sm_ptr, m_route_cache, TreeFor(depot));
+    DeliveryResult result = GenerateDeliveryPlan(depot, deliveries, plan);
+    if(result != DELIVERY_SUCCESS)
+        return result;
+    plan.GetCommands(commands);
+    total_dist_travelled = plan.TotalDistance();
+    return DELIVERY_SUCCESS;
+}
+
+DeliveryResult DeliveryPlannerImpl::GenerateDeliveryPlan(
+    const GeoCoord& depot,
+    const vector<DeliveryRequest>& deliveries,
+    DeliveryPlan& plan) const
+{
+    // use delivery optimizer to reorder deliveries; it puts deliveries to
+    // one place next to each other, so they make a single stop
     DeliveryOptimizer optimization_engine(m_sm_ptr);
-    double old_crow_dist, new_crow_dist;
+    optimization_engine.SetDepotTree(TreeFor(depot));
+    double old_dist, new_dist;
     vector<DeliveryRequest> optimized_deliveries = deliveries;
-    optimization_engine.OptimizeDeliveryOrder(depot, optimized_deliveries, old_crow_dist, new_crow_dist);
-    
-    DeliveryResult delivery_status;
-    total_dist_travelled = 0;
-    double new_distance = 0;
-    list<StreetSegment> total_path, path_buffer;
-    PointToPointRouter path(m_sm_ptr);
-        
-    // get the path from depot to first locaton
-    if (AddDelivery(delivery_status, path_buffer, total_path, new_distance, path, depot, optimized_deliveries.front().location, path_buffer, total_dist_travelled) != DELIVERY_SUCCESS)
-        return delivery_status;
-        
-    // generate a route between all delivery locations
-    for(auto delivery_it = optimized_deliveries.begin(); delivery_it != prev(optimized_deliveries.end()); delivery_it++)
-        if(AddDelivery(delivery_status, path_buffer, total_path, new_distance, path, delivery_it->location,
-           next(delivery_it)->location, path_buffer, total_dist_travelled) != DELIVERY_SUCCESS)
-            return delivery_status;
-        
-    // get the path from the last location to the depot
-    if (AddDelivery(delivery_status, path_buffer, total_path, new_distance, path, optimized_deliveries.back().location, depot, path_buffer, total_dist_travelled) != DELIVERY_SUCCESS)
-        return delivery_status;
-        
-    // generate commands
-    auto delivery_tracker = optimized_deliveries.begin();
+    optimization_engine.OptimizeDeliveryOrder(depot, optimized_deliveries, old_dist, new_dist, m_optimizer_options);
+    return plan.Route(depot, optimized_deliveries);
+}
+
+void DeliveryPlannerImpl::GenerateDeliveryPlans(
+    const vector<DeliveryManifest>& manifests,
+    vector<ManifestPlan>& plans) const
+{
+    plans.assign(manifests.size(), ManifestPlan());
+    // Start the biggest manifests first, so the batch doesn't end waiting
+    // on one long plan begun last.
+    vector<size_t> order(manifests.size());
+    for(size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return manifests[a].deliveries.size() > manifests[b].deliveries.size();
+    });
+    // One thread per core takes manifests in turn. They're threads of their
+    // own rather than pool tasks: a plan waiting on its legs runs other
+    // queued pool tasks meanwhile, and were those whole manifests, each
+    // would be timed as part of the one it ran inside.
+    atomic<size_t> next_manifest(0);
+    auto plan_manifests = [&]() {
+        for(size_t i = next_manifest++; i < order.size(); i = next_manifest++)
+        {
+            const DeliveryManifest& manifest = manifests[order[i]];
+            ManifestPlan& plan = plans[order[i]];
+            auto start = chrono::steady_clock::now();
+            plan.result = GenerateDeliveryPlan(manifest.depot, manifest.deliveries, plan.commands, plan.totalDistance);
+            plan.elapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        }
+    };
+    size_t num_threads = min(size_t(ThreadPool::Shared().ThreadCount()), order.size());
+    vector<thread> threads;
+    for(size_t i = 1; i < num_threads; i++)
+        threads.emplace_back(plan_manifests);
+    plan_manifests();
+    for(thread& t : threads)
+        t.join();
+}
+
+void addLegCommands(const StreetMap& sm, NodeId start, const vector<EdgeId>& leg, vector<DeliveryCommand>& commands)
+{
     DeliveryCommand next_command;
-    double angle;
-    
-    // if there is a delivery at the depot
-    if(delivery_tracker->location == total_path.front().start)
-    {
-        next_command.InitAsDeliverCommand(delivery_tracker -> item);
-        commands.push_back(next_command);
-        delivery_tracker++;
-    }
-    
-    // put in first proceed command
-    next_command.InitAsProceedCommand(getProceedDirection(total_path.front()),
-                                     total_path.front().name,
-                                     getSegDist(total_path.front()));
-    commands.push_back(next_command);
+    FixedCoord seg_start = sm.NodeFixedCoord(start);
+    uint32_t prev_street = 0;
+    double prev_line_angle = 0.0, angle;
     
-    // fill in rest of commands until depot at end
-    for(auto current_seg = next(total_path.begin()); current_seg != total_path.end();
-        current_seg++)
+    for(auto edge_it = leg.begin(); edge_it != leg.end(); edge_it++)
     {
-        // first, check if we need to deliver to the current location
-        if(delivery_tracker->location == current_seg->start)
-        {
-            next_command.InitAsDeliverCommand(delivery_tracker->item);
-            commands.push_back(next_command);
-            delivery_tracker++;
-            // next command will be a Proceed
-            next_command.InitAsProceedCommand(getProceedDirection(*current_seg),
-                                             current_seg->name,
-                                             getSegDist(*current_seg));
-            commands.push_back(next_command);
-            continue;
-        }
+        FixedCoord seg_end = sm.NodeFixedCoord(sm.EdgeTarget(*edge_it));
+        uint32_t seg_street = sm.EdgeStreet(*edge_it);
+        string seg_name = sm.StreetName(seg_street);
+        double seg_dist = sm.EdgeLength(*edge_it);
+        double seg_line_angle = getLineAngle(seg_start, seg_end);
+        double seg_angle = rad2deg(seg_line_angle);
+        if(seg_angle < 0)
+            seg_angle += 360;
         
-        auto prev_line = prev(current_seg);
-        // above line modifies current_seg, so we need to compensate
-        // by using next() on the next line
-        auto current_line = next(prev_line);
-        angle = angleBetween2Lines(*prev_line, *current_line);
-        
-        // check if it's a proceeed case first
-        if(angle < 1.0 || angle > 359.0)
+        // the first segment of a leg always starts with a proceed command
+        if(edge_it == leg.begin())
         {
-            // first, check if last command was proceed of same name
-            if(commands.back().Description()[0] == 'P' && commands.back().StreetName() == current_seg->name)
-                commands.back().IncreaseDistance(getSegDist(*current_seg));
-            else
-            {
-                next_command.InitAsProceedCommand(getProceedDirection(*current_seg), current_seg->name,
-                                                  getSegDist(*current_seg));
-                commands.push_back(next_command);
-            }
+            next_command.InitAsProceedCommand(getProceedDirection(seg_angle), seg_name, seg_dist);
+            commands.push_back(next_command);
         }
-        // must be a turn case
         else
         {
-            // if it's a turn, that's our first action on a segment
-            if(angle >= 1.0 && angle < 180.0)
-                next_command.InitAsTurnCommand("left", current_seg->name);
-            else if(angle >= 180.0 && angle <= 359.0)
-                next_command.InitAsTurnCommand("right", current_seg->name);
+            // angle between the previous segment and this one, as angleBetween2Lines
+            angle = rad2deg(seg_line_angle - prev_line_angle);
+            if(angle < 0)
+                angle += 360;
             
-            if(current_seg->name != prev_line->name)
+            // check if it's a proceeed case first
+            if(angle < 1.0 || angle > 359.0)
             {
-                commands.push_back(next_command);
-                // we must use Proceed to get to the next segment
-                next_command.InitAsProceedCommand(getProceedDirection(*current_seg), current_seg->name,
-                                                  getSegDist(*current_seg));
-                commands.push_back(next_command);
+                // first, check if last command was proceed of same name
+                if(commands.back().Description()[0] == 'P' && commands.back().StreetName() == seg_name)
+                    commands.back().IncreaseDistance(seg_dist);
+                else
+                {
+                    next_command.InitAsProceedCommand(getProceedDirection(seg_angle), seg_name, seg_dist);
+                    commands.push_back(next_command);
+                }
             }
+            // must be a turn case
             else
-                commands.back().IncreaseDistance(getSegDist(*current_seg));
+            {
+                // if it's a turn, that's our first action on a segment
+                if(angle >= 1.0 && angle < 180.0)
+                    next_command.InitAsTurnCommand("left", seg_name);
+                else if(angle >= 180.0 && angle <= 359.0)
+                    next_command.InitAsTurnCommand("right", seg_name);
+                
+                if(seg_street != prev_street)
+                {
+                    commands.push_back(next_command);
+                    // we must use Proceed to get to the next segment
+                    next_command.InitAsProceedCommand(getProceedDirection(seg_angle), seg_name, seg_dist);
+                    commands.push_back(next_command);
+                }
+                else
+                    commands.back().IncreaseDistance(seg_dist);
+            }
         }
-    }
-    // check if there's a delivery at the depot at the very end
-    if(delivery_tracker != optimized_deliveries.end())
-        next_command.InitAsDeliverCommand(delivery_tracker->item);
         
-    return DELIVERY_SUCCESS;
-}
-
-DeliveryResult DeliveryPlannerImpl::AddDelivery(DeliveryResult& delivery_status, list<StreetSegment>& path_buffer,
-                                                list<StreetSegment>& total_path, double& new_distance,
-                                                PointToPointRouter& path, const GeoCoord& start, const GeoCoord& end,
-                                                list<StreetSegment>& route, double& total_dist_travelled) const
-{
-    delivery_status = path.GeneratePointToPointRoute(start, end, route, total_dist_travelled);
-    if(delivery_status != DELIVERY_SUCCESS)
-        return delivery_status;
-    else
-    {
-        total_path.splice(total_path.end(), path_buffer);
-        total_dist_travelled += new_distance;
-        return DELIVERY_SUCCESS;
+        prev_line_angle = seg_line_angle;
+        prev_street = seg_street;
+        seg_start = seg_end;
     }
 }
 
 // assign direction to angle
-string getProceedDirection(StreetSegment seg)
+string getProceedDirection(double angle)
 {
-    double angle = angleOfLine(seg);
     if(angle >= 0 && angle < 22.5)
         return "east";
     else if(angle >= 22.5 && angle < 67.5)
@@ -201,13 +616,55 @@ string getProceedDirection(StreetSegment seg)
         return "INVALID";
 }
 
-double getSegDist(StreetSegment seg)
+// angle of the line between two points in radians, measured the same
+// way as angleOfLine and angleBetween2Lines measure it
+double getLineAngle(const FixedCoord& start, const FixedCoord& end)
 {
-    return distanceEarthMiles(seg.start, seg.end);
+    return atan2(end.lat/1e7 - start.lat/1e7, end.lon/1e7 - start.lon/1e7);
 }
 
 // Functions added by Professors Nachenburg and Smallberg for grading purposes
 
+DeliveryPlan::DeliveryPlan(const StreetMap* sm, RouteCache* route_cache, const DepotTree* depot_tree)
+{
+    m_impl = new DeliveryPlanImpl(sm, route_cache, depot_tree);
+}
+
+DeliveryPlan::~DeliveryPlan()
+{
+    delete m_impl;
+}
+
+DeliveryResult DeliveryPlan::Route(const GeoCoord& depot, const vector<DeliveryRequest>& deliveries)
+{
+    return m_impl->Route(depot, deliveries);
+}
+
+DeliveryResult DeliveryPlan::InsertDelivery(const DeliveryRequest& delivery)
+{
+    return m_impl->InsertDelivery(delivery);
+}
+
+DeliveryResult DeliveryPlan::RemoveDelivery(const DeliveryRequest& delivery)
+{
+    return m_impl->RemoveDelivery(delivery);
+}
+
+vector<DeliveryRequest> DeliveryPlan::Deliveries() const
+{
+    return m_impl->Deliveries();
+}
+
+void DeliveryPlan::GetCommands(vector<DeliveryCommand>& commands) const
+{
+    m_impl->GetCommands(commands);
+}
+
+double DeliveryPlan::TotalDistance() const
+{
+    return m_impl->TotalDistance();
+}
+
 DeliveryPlanner::DeliveryPlanner(const StreetMap* sm)
 {
     m_impl = new DeliveryPlannerImpl(sm);
@@ -226,3 +683,33 @@ DeliveryResult DeliveryPlanner::GenerateDeliveryPlan(
 {
     return m_impl->GenerateDeliveryPlan(depot, deliveries, commands, total_dist_travelled);
 }
+
+DeliveryResult DeliveryPlanner::GenerateDeliveryPlan(
+    const GeoCoord& depot,
+    const vector<DeliveryRequest>& deliveries,
+    DeliveryPlan& plan) const
+{
+    return m_impl->GenerateDeliveryPlan(depot, deliveries, plan);
+}
+
+void DeliveryPlanner::GenerateDeliveryPlans(
+    const vector<DeliveryManifest>& manifests,
+    vector<ManifestPlan>& plans) const
+{
+    m_impl->GenerateDeliveryPlans(manifests, plans);
+}
+
+void DeliveryPlanner::SetOptimizerOptions(const OptimizerOptions& options)
+{
+    m_impl->SetOptimizerOptions(options);
+}
+
+void DeliveryPlanner::SetRouteCache(RouteCache* cache)
+{
+    m_impl->SetRouteCache(cache);
+}
+
+DeliveryResult DeliveryPlanner::AddDepot(const GeoCoord& depot)
+{
+    return m_impl->AddDepot(depot);
+}
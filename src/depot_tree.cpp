@@ -0,0 +1,149 @@
+//  Author:  Noah Himed
+//  Date:    16 October 2026
+//  Summary: Keeps the shortest path tree from a depot over a whole
+//           StreetMap and reads routes to and from the depot off it.
+
+#include "provided.h"
+#include "graph_search.h"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+class DepotTreeImpl
+{
+public:
+    DepotTreeImpl(const StreetMap* sm);
+    ~DepotTreeImpl();
+    DeliveryResult Build(const GeoCoord& depot);
+    bool IsBuilt() const;
+    NodeId Root() const;
+    double Distance(NodeId node) const;
+    DeliveryResult RouteFromDepot(NodeId node, vector<EdgeId>& route, double& total_dist_travelled) const;
+    DeliveryResult RouteToDepot(NodeId node, vector<EdgeId>& route, double& total_dist_travelled) const;
+private:
+    // NO_ROUTE, or BAD_COORD if the tree isn't built or node isn't on the map
+    DeliveryResult Check(NodeId node) const;
+
+    const StreetMap* m_sm_ptr;
+    NodeId m_root;
+    // each node's distance from the root, and the node and edge it's
+    // reached from on the way
+    vector<double> m_distances;
+    vector<NodeId> m_parents;
+    vector<EdgeId> m_parent_edges;
+};
+
+DepotTreeImpl::DepotTreeImpl(const StreetMap* sm)
+: m_sm_ptr(sm), m_root(NO_NODE)
+{}
+
+DepotTreeImpl::~DepotTreeImpl()
+{}
+
+DeliveryResult DepotTreeImpl::Build(const GeoCoord& depot)
+{
+    NodeId root;
+    if(!m_sm_ptr->SnapToNode(depot, root))
+        return BAD_COORD;
+    shortestPathTree(*m_sm_ptr, root, m_distances, &m_parents, nullptr, &m_parent_edges);
+    m_root = root;
+    return DELIVERY_SUCCESS;
+}
+
+bool DepotTreeImpl::IsBuilt() const
+{
+    return m_root != NO_NODE;
+}
+
+NodeId DepotTreeImpl::Root() const
+{
+    return m_root;
+}
+
+double DepotTreeImpl::Distance(NodeId node) const
+{
+    if(!IsBuilt() || node >= m_distances.size())
+        return numeric_limits<double>::infinity();
+    return m_distances[node];
+}
+
+DeliveryResult DepotTreeImpl::Check(NodeId node) const
+{
+    if(!IsBuilt() || node >= m_distances.size())
+        return BAD_COORD;
+    return isinf(m_distances[node]) ? NO_ROUTE : DELIVERY_SUCCESS;
+}
+
+DeliveryResult DepotTreeImpl::RouteFromDepot(NodeId node, vector<EdgeId>& route, double& total_dist_travelled) const
+{
+    route.clear();
+    total_dist_travelled = 0;
+    DeliveryResult result = Check(node);
+    if(result != DELIVERY_SUCCESS)
+        return result;
+    // walk up to the root, then turn the edges around into driving order
+    for(NodeId at = node; at != m_root; at = m_parents[at])
+        route.push_back(m_parent_edges[at]);
+    reverse(route.begin(), route.end());
+    total_dist_travelled = m_distances[node];
+    return DELIVERY_SUCCESS;
+}
+
+DeliveryResult DepotTreeImpl::RouteToDepot(NodeId node, vector<EdgeId>& route, double& total_dist_travelled) const
+{
+    route.clear();
+    total_dist_travelled = 0;
+    DeliveryResult result = Check(node);
+    if(result != DELIVERY_SUCCESS)
+        return result;
+    // walking up to the root is already driving order; each tree edge is
+    // just followed the other way
+    for(NodeId at = node; at != m_root; at = m_parents[at])
+        route.push_back(reverseEdge(*m_sm_ptr, m_parents[at], m_parent_edges[at]));
+    total_dist_travelled = m_distances[node];
+    return DELIVERY_SUCCESS;
+}
+
+DepotTree::DepotTree(const StreetMap* sm)
+{
+    m_impl = new DepotTreeImpl(sm);
+}
+
+DepotTree::~DepotTree()
+{
+    delete m_impl;
+}
+
+DeliveryResult DepotTree::Build(const GeoCoord& depot)
+{
+    return m_impl->Build(depot);
+}
+
+bool DepotTree::IsBuilt() const
+{
+    return m_impl->IsBuilt();
+}
+
+NodeId DepotTree::Root() const
+{
+    return m_impl->Root();
+}
+
+double DepotTree::Distance(NodeId node) const
+{
+    return m_impl->Distance(node);
+}
+
+DeliveryResult DepotTree::RouteFromDepot(NodeId node, vector<EdgeId>& route, double& total_dist_travelled) const
+{
+    return m_impl->RouteFromDepot(node, route, total_dist_travelled);
+}
+
+DeliveryResult DepotTree::RouteToDepot(NodeId node, vector<EdgeId>& route, double& total_dist_travelled) const
+{
+    return m_impl->RouteToDepot(node, route, total_dist_travelled);
+}
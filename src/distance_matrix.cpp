@@ -0,0 +1,171 @@
+//  Author:  Noah Himed
+//  Date:    16 October 2026
+//  Summary: Computes the shortest road distances between every pair of a
+//           set of points with one-to-many Dijkstra sweeps.
+
+#include "provided.h"
+#include "graph_search.h"
+#include "thread_pool.h"
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+class DistanceMatrixImpl
+{
+public:
+    DistanceMatrixImpl(const StreetMap* sm);
+    ~DistanceMatrixImpl();
+    DeliveryResult Compute(const vector<GeoCoord>& points);
+    DeliveryResult Compute(const vector<NodeId>& nodes);
+    int Size() const;
+    double Distance(int from, int to) const;
+private:
+    // one Dijkstra from the row'th distinct node, run until every distinct
+    // node after it is settled; distances are symmetric, so this fills in
+    // that row right of the diagonal and the matching column below it
+    void ComputeRow(size_t row);
+
+    const StreetMap* m_sm_ptr;
+    // the distinct nodes among the points, and which of them each point is
+    vector<NodeId> m_nodes;
+    vector<size_t> m_point_nodes;
+    // for each node of the map, its index in m_nodes, or NO_NODE
+    vector<NodeId> m_node_index;
+    // distances between the distinct nodes, row by row
+    vector<double> m_distances;
+};
+
+DistanceMatrixImpl::DistanceMatrixImpl(const StreetMap* sm)
+: m_sm_ptr(sm)
+{}
+
+DistanceMatrixImpl::~DistanceMatrixImpl()
+{}
+
+DeliveryResult DistanceMatrixImpl::Compute(const vector<GeoCoord>& points)
+{
+    vector<NodeId> nodes(points.size());
+    for(size_t i = 0; i < points.size(); i++)
+        if(!m_sm_ptr->FindNode(points[i], nodes[i]))
+        {
+            m_nodes.clear();
+            m_point_nodes.clear();
+            m_distances.clear();
+            return BAD_COORD;
+        }
+    return Compute(nodes);
+}
+
+DeliveryResult DistanceMatrixImpl::Compute(const vector<NodeId>& nodes)
+{
+    const NodeId num_map_nodes = m_sm_ptr->NodeCount();
+    m_nodes.clear();
+    m_point_nodes.clear();
+    m_distances.clear();
+    for(NodeId node : nodes)
+        if(node >= num_map_nodes)
+            return BAD_COORD;
+
+    // several points may share a node, such as two deliveries to one address
+    m_node_index.assign(num_map_nodes, NO_NODE);
+    for(NodeId node : nodes)
+    {
+        if(m_node_index[node] == NO_NODE)
+        {
+            m_node_index[node] = NodeId(m_nodes.size());
+            m_nodes.push_back(node);
+        }
+        m_point_nodes.push_back(m_node_index[node]);
+    }
+
+    const size_t num_distinct = m_nodes.size();
+    m_distances.assign(num_distinct*num_distinct, numeric_limits<double>::infinity());
+    for(size_t row = 0; row < num_distinct; row++)
+        m_distances[row*num_distinct + row] = 0;
+    // no two rows write the same entry, so they're all swept at once
+    parallelFor(num_distinct, [this](size_t row) { ComputeRow(row); });
+    vector<NodeId>().swap(m_node_index);
+    return DELIVERY_SUCCESS;
+}
+
+void DistanceMatrixImpl::ComputeRow(size_t row)
+{
+    const size_t num_distinct = m_nodes.size();
+    size_t num_remaining = num_distinct - row - 1;
+    if(num_remaining == 0)
+        return;
+
+    SearchSpace& search = threadSearchSpace(0);
+    search.Reset(m_sm_ptr->NodeCount());
+    search.Update(m_nodes[row], 0, NO_NODE, NO_EDGE);
+    search.Push(m_nodes[row], 0);
+    while(!search.QueueEmpty())
+    {
+        NodeId node = search.PopMin();
+        if(search.Settled(node))
+            continue;
+        search.Settle(node);
+
+        NodeId column = m_node_index[node];
+        if(column != NO_NODE && column > row)
+        {
+            m_distances[row*num_distinct + column] = search.Cost(node);
+            m_distances[column*num_distinct + row] = search.Cost(node);
+            if(--num_remaining == 0)
+                break;
+        }
+
+        for(StreetEdge edge : m_sm_ptr->Neighbors(node))
+        {
+            double cost = search.Cost(node) + edge.length;
+            if(!search.Reached(edge.target) || cost < search.Cost(edge.target))
+            {
+                search.Update(edge.target, cost, node, edge.id);
+                search.Push(edge.target, cost);
+            }
+        }
+    }
+}
+
+int DistanceMatrixImpl::Size() const
+{
+    return int(m_point_nodes.size());
+}
+
+double DistanceMatrixImpl::Distance(int from, int to) const
+{
+    return m_distances[m_point_nodes[from]*m_nodes.size() + m_point_nodes[to]];
+}
+
+DistanceMatrix::DistanceMatrix(const StreetMap* sm)
+{
+    m_impl = new DistanceMatrixImpl(sm);
+}
+
+DistanceMatrix::~DistanceMatrix()
+{
+    delete m_impl;
+}
+
+DeliveryResult DistanceMatrix::Compute(const vector<GeoCoord>& points)
+{
+    return m_impl->Compute(points);
+}
+
+DeliveryResult DistanceMatrix::Compute(const vector<NodeId>& nodes)
+{
+    return m_impl->Compute(nodes);
+}
+
+int DistanceMatrix::Size() const
+{
+    return m_impl->Size();
+}
+
+double DistanceMatrix::Distance(int from, int to) const
+{
+    return m_impl->Distance(from, to);
+}
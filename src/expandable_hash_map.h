@@ -2,38 +2,67 @@
 //  Date:    19 March 2020
 //  Summary: Defines and implements a hash map that doubles
 //           in size once a pre-defined load factor is met.
+//
+//  Entries live in one flat array using open addressing. Slots are grouped
+//  16 at a time, each with a control byte holding 7 bits of its key's hash
+//  (or marking it empty or erased), so a probe compares a whole group's
+//  control bytes at once with SSE2 and only touches the keys whose hash
+//  bits match.
 
 #ifndef EXPANDABLE_HASH_MAP
 #define EXPANDABLE_HASH_MAP
 
-#include <vector>
-#include <list>
-#include <functional>
-#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <utility>
 
-const int INITIAL_SIZE = 8;
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+const int INITIAL_SIZE = 16;
 
 template<typename KeyType, typename ValueType>
 class ExpandableHashMap
 {
 public:
-	ExpandableHashMap(double max_load_factor = 0.5);
+	ExpandableHashMap(double max_load_factor = 0.875);
 	~ExpandableHashMap();
+	  // removes every pair and gives back the map's memory
 	void Reset();
+	  // removes every pair but keeps the buckets for reuse
+	void Clear();
+	  // makes room for num_pairs pairs without any further growth
+	void Reserve(int num_pairs);
 	int Size() const;
-    // Attempts to add value-key pair into map, does nothing if key is
+    // Attempts to add value-key pair into map, updating the value if key is
     // already in the map
 	void Associate(const KeyType& key, const ValueType& value);
+	void Associate(KeyType&& key, ValueType&& value);
+
+	  // adds a pair whose value is built from args unless key is already in
+	  // the map; either way returns a pointer to the key's value
+	template<typename... Args>
+	ValueType* Emplace(const KeyType& key, Args&&... args);
+
+	  // returns true if key was in the map
+	bool Erase(const KeyType& key);
 
+	  // Lookups may use any type that has its own hasher() giving the same hash
+	  // as the equivalent KeyType and that compares equal to KeyType with ==.
+	  // Pointers returned stay valid until the next pair is added.
 	  // for a map that can't be modified, return a pointer to const ValueType
-	const ValueType* Find(const KeyType& key) const;
+	template<typename LookupType>
+	const ValueType* Find(const LookupType& key) const;
 
 	  // for a modifiable map, return a pointer to modifiable ValueType
-	ValueType* Find(const KeyType& key)
+	template<typename LookupType>
+	ValueType* Find(const LookupType& key)
 	{
 		return const_cast<ValueType*>(const_cast<const ExpandableHashMap*>(this)->Find(key));
 	}
-    
+
 	  // C++11 syntax for preventing copying and assignment
 	ExpandableHashMap(const ExpandableHashMap&) = delete;
 	ExpandableHashMap& operator=(const ExpandableHashMap&) = delete;
@@ -41,42 +70,79 @@ public:
 private:
     struct PAIR
     {
-        PAIR(KeyType key, ValueType val): m_key(key), m_val(val) {}
+        template<typename K, typename... Args>
+        PAIR(K&& key, Args&&... args): m_key(std::forward<K>(key)), m_val(std::forward<Args>(args)...) {}
         KeyType m_key;
         ValueType m_val;
     };
-    
-    std::vector<std::list<PAIR>*> m_map;
+
+    static const int GROUP_SIZE = 16;
+    // control byte values; a filled slot holds the low 7 bits of its hash
+    static const int8_t EMPTY = -128;
+    static const int8_t ERASED = -2;
+
+    int8_t* m_ctrl;
+    PAIR* m_pairs;
     int m_num_pairs;
+    int m_num_erased;
     int m_size;
     double m_max_load;
-    
-    // returns true if pair was added to map, false if key was already in the map and the pair was updated
-    bool AddPairToMap(std::vector<std::list<PAIR>*> &map, KeyType key, ValueType val, bool copying=false);
+
+    static uint64_t MixHash(unsigned int hash);
+    // bitmask of the slots in a group whose control byte equals value
+    static unsigned int MatchGroup(const int8_t* group, int8_t value);
+    template<typename LookupType>
+    int FindSlot(const LookupType& key, uint64_t hash) const;
+    // finds the slot for key, adding an unset one if key isn't in the map;
+    // returns true if the slot was added
+    bool ClaimSlot(const KeyType& key, int& slot);
+    int FindFreeSlot(uint64_t hash) const;
+    void Rehash(int new_size);
+    void Allocate(int size);
+    void DestroyPairs();
 };
 
 template<typename KeyType, typename ValueType>
 ExpandableHashMap<KeyType, ValueType>::ExpandableHashMap(double max_load_factor)
-:m_map(INITIAL_SIZE, nullptr)
 {
-    m_num_pairs = 0;
-    m_size = INITIAL_SIZE;
-    m_max_load = max_load_factor;
-    
+    m_max_load = (max_load_factor > 0.0 && max_load_factor < 0.9375) ? max_load_factor : 0.9375;
+    Allocate(INITIAL_SIZE);
 }
 
 template<typename KeyType, typename ValueType>
 ExpandableHashMap<KeyType, ValueType>::~ExpandableHashMap()
 {
-    Reset();
+    DestroyPairs();
+    delete [] m_ctrl;
+    ::operator delete(m_pairs);
 }
 
 template<typename KeyType, typename ValueType>
 void ExpandableHashMap<KeyType, ValueType>::Reset()
 {
-    for(int i = 0; i < m_size; i++)
-        delete m_map[i];
-    m_map.resize(INITIAL_SIZE, nullptr);
+    DestroyPairs();
+    delete [] m_ctrl;
+    ::operator delete(m_pairs);
+    Allocate(INITIAL_SIZE);
+}
+
+template<typename KeyType, typename ValueType>
+void ExpandableHashMap<KeyType, ValueType>::Clear()
+{
+    DestroyPairs();
+    memset(m_ctrl, EMPTY, m_size);
+    m_num_pairs = 0;
+    m_num_erased = 0;
+}
+
+template<typename KeyType, typename ValueType>
+void ExpandableHashMap<KeyType, ValueType>::Reserve(int num_pairs)
+{
+    int new_size = m_size;
+    while(double(num_pairs) > new_size*m_max_load)
+        new_size *= 2;
+    if(new_size != m_size)
+        Rehash(new_size);
 }
 
 template<typename KeyType, typename ValueType>
@@ -88,86 +154,197 @@ int ExpandableHashMap<KeyType, ValueType>::Size() const
 template<typename KeyType, typename ValueType>
 void ExpandableHashMap<KeyType, ValueType>::Associate(const KeyType& key, const ValueType& value)
 {
-    // attempt to add value to map
-    if(AddPairToMap(m_map, key, value))
+    int slot;
+    if(ClaimSlot(key, slot))
+        new (&m_pairs[slot]) PAIR(key, value);
+    else
+        m_pairs[slot].m_val = value;
+}
+
+template<typename KeyType, typename ValueType>
+void ExpandableHashMap<KeyType, ValueType>::Associate(KeyType&& key, ValueType&& value)
+{
+    int slot;
+    if(ClaimSlot(key, slot))
+        new (&m_pairs[slot]) PAIR(std::move(key), std::move(value));
+    else
+        m_pairs[slot].m_val = std::move(value);
+}
+
+template<typename KeyType, typename ValueType>
+template<typename... Args>
+ValueType* ExpandableHashMap<KeyType, ValueType>::Emplace(const KeyType& key, Args&&... args)
+{
+    int slot;
+    if(ClaimSlot(key, slot))
+        new (&m_pairs[slot]) PAIR(key, std::forward<Args>(args)...);
+    return &m_pairs[slot].m_val;
+}
+
+template<typename KeyType, typename ValueType>
+bool ExpandableHashMap<KeyType, ValueType>::Erase(const KeyType& key)
+{
+    unsigned int hasher(const KeyType& k);
+    int slot = FindSlot(key, MixHash(hasher(key)));
+    if(slot < 0)
+        return false;
+
+    m_pairs[slot].~PAIR();
+    m_num_pairs--;
+    // a probe only moves past a group with no empty slots, so if this group
+    // still has one no probe can depend on the slot and it can be reused
+    const int8_t* group = m_ctrl + (slot & ~(GROUP_SIZE - 1));
+    if(MatchGroup(group, EMPTY) != 0)
+        m_ctrl[slot] = EMPTY;
+    else
     {
-        // if a pair was added, and map wasn't just updated
-        m_num_pairs++;
-    
-        // if number of buckets filled causes load to go over pre-defined maxLoad
-        if(double(m_num_pairs)/double(m_size) > m_max_load)
-        {
-            // create map with two times current number of buckets
-            std::vector<std::list<PAIR>*> new_map(2*m_size, nullptr);
-            // iterate through all values in the old map
-            for(int bucket_num = 0; bucket_num < m_size; bucket_num++)
-                // if the bucket is filled, reallocate all key-value pairs to new map
-                if(m_map[bucket_num] != nullptr)
-                    for(auto pair = m_map[bucket_num]->begin(); pair != m_map[bucket_num]->end(); pair++)
-                        AddPairToMap(new_map, pair->m_key, pair->m_val, true);
-            
-            // delete all buckets in current map
-            Reset();
-            // replace the current map with the new map
-            m_map = new_map;
-            m_size *= 2;
-        }
+        m_ctrl[slot] = ERASED;
+        m_num_erased++;
     }
+    return true;
+}
+
+template<typename KeyType, typename ValueType>
+template<typename LookupType>
+const ValueType* ExpandableHashMap<KeyType, ValueType>::Find(const LookupType& key) const
+{
+    unsigned int hasher(const LookupType& k);
+    int slot = FindSlot(key, MixHash(hasher(key)));
+    return slot < 0 ? nullptr : &m_pairs[slot].m_val;
 }
 
+template<typename KeyType, typename ValueType>
+uint64_t ExpandableHashMap<KeyType, ValueType>::MixHash(unsigned int hash)
+{
+    // spread the hasher's bits over 64 so that weak hashes (such as
+    // the identity on integers) still use every group
+    uint64_t mixed = uint64_t(hash) * 0x9E3779B97F4A7C15ULL;
+    return mixed ^ (mixed >> 29);
+}
 
 template<typename KeyType, typename ValueType>
-const ValueType* ExpandableHashMap<KeyType, ValueType>::Find(const KeyType& key) const
+unsigned int ExpandableHashMap<KeyType, ValueType>::MatchGroup(const int8_t* group, int8_t value)
 {
-    // go through each pair, and if a match is found for passed in key,
-    // return a pointer to the corresponding value
-    unsigned int hasher(const KeyType& k);
-    unsigned int bucket_num = hasher(key);
-    bucket_num %= m_map.size();
-    if(m_map[bucket_num] != nullptr)
-        for(auto bucket_it = m_map[bucket_num]->begin(); bucket_it != m_map[bucket_num] -> end(); bucket_it++)
-            if(bucket_it->m_key == key)
-                return &(bucket_it->m_val);
-    
-    return nullptr;
+#ifdef __SSE2__
+    __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+    return unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(value))));
+#else
+    unsigned int mask = 0;
+    for(int i = 0; i < GROUP_SIZE; i++)
+        if(group[i] == value)
+            mask |= 1u << i;
+    return mask;
+#endif
 }
 
 template<typename KeyType, typename ValueType>
-bool ExpandableHashMap<KeyType, ValueType>::AddPairToMap(std::vector<std::list<PAIR>*> &map,
-                                                         KeyType key, ValueType val,
-                                                         bool copying)
+template<typename LookupType>
+int ExpandableHashMap<KeyType, ValueType>::FindSlot(const LookupType& key, uint64_t hash) const
 {
-    unsigned int hasher(const KeyType& k);
-    unsigned int bucket_num = hasher(key);
-    bucket_num %= map.size();
-    
-    // if the bucket is filled, check if a match for passed in key can be found
-    if(map[bucket_num] != nullptr)
+    const int8_t tag = int8_t(hash & 0x7F);
+    const int group_mask = m_size/GROUP_SIZE - 1;
+    int group_num = int(hash >> 7) & group_mask;
+    // visit groups in triangular-number order, which reaches every group
+    // when the number of groups is a power of two
+    for(int probe = 1; probe <= group_mask + 1; probe++)
     {
-        if(!copying)
+        const int8_t* group = m_ctrl + group_num*GROUP_SIZE;
+        for(unsigned int matches = MatchGroup(group, tag); matches != 0; matches &= matches - 1)
         {
-            for(auto pair = map[bucket_num] -> begin(); pair != map[bucket_num] -> end(); pair++)
-            {
-                // if a match is found, update corresponding value and
-                // return to indicate new pair wasn't added
-                if(key == pair->m_key)
-                {
-                    pair->m_val = val;
-                    return false;
-                }
-            }
+            int slot = group_num*GROUP_SIZE + __builtin_ctz(matches);
+            if(key == m_pairs[slot].m_key)
+                return slot;
         }
+        if(MatchGroup(group, EMPTY) != 0)
+            return -1;
+        group_num = (group_num + probe) & group_mask;
     }
-    else
-        // if the bucket isn't filled, add new list
-        map[bucket_num] = new std::list<PAIR>;
- 
-    PAIR new_pair(key, val);
-    map[bucket_num]->push_back(new_pair);
+    return -1;
+}
 
-    // indicate a new pair has been added
+template<typename KeyType, typename ValueType>
+bool ExpandableHashMap<KeyType, ValueType>::ClaimSlot(const KeyType& key, int& slot)
+{
+    unsigned int hasher(const KeyType& k);
+    uint64_t hash = MixHash(hasher(key));
+    slot = FindSlot(key, hash);
+    if(slot >= 0)
+        return false;
+
+    // if adding a pair causes load to go over pre-defined maxLoad, grow the
+    // map, or just clear out erased slots if they make up much of the load
+    if(double(m_num_pairs + m_num_erased + 1) > m_size*m_max_load)
+    {
+        Rehash(double(m_num_pairs + 1) > m_size*m_max_load/2 ? 2*m_size : m_size);
+    }
+
+    slot = FindFreeSlot(hash);
+    if(m_ctrl[slot] == ERASED)
+        m_num_erased--;
+    m_ctrl[slot] = int8_t(hash & 0x7F);
+    m_num_pairs++;
     return true;
 }
 
+template<typename KeyType, typename ValueType>
+int ExpandableHashMap<KeyType, ValueType>::FindFreeSlot(uint64_t hash) const
+{
+    const int group_mask = m_size/GROUP_SIZE - 1;
+    int group_num = int(hash >> 7) & group_mask;
+    for(int probe = 1; ; probe++)
+    {
+        const int8_t* group = m_ctrl + group_num*GROUP_SIZE;
+        unsigned int free_slots = MatchGroup(group, EMPTY) | MatchGroup(group, ERASED);
+        if(free_slots != 0)
+            return group_num*GROUP_SIZE + __builtin_ctz(free_slots);
+        group_num = (group_num + probe) & group_mask;
+    }
+}
+
+template<typename KeyType, typename ValueType>
+void ExpandableHashMap<KeyType, ValueType>::Rehash(int new_size)
+{
+    int8_t* old_ctrl = m_ctrl;
+    PAIR* old_pairs = m_pairs;
+    int old_size = m_size;
+    Allocate(new_size);
+
+    unsigned int hasher(const KeyType& k);
+    // move every pair over; keys are known to be distinct so there's no
+    // need to look for them first
+    for(int i = 0; i < old_size; i++)
+    {
+        if(old_ctrl[i] < 0)
+            continue;
+        uint64_t hash = MixHash(hasher(old_pairs[i].m_key));
+        int slot = FindFreeSlot(hash);
+        m_ctrl[slot] = int8_t(hash & 0x7F);
+        new (&m_pairs[slot]) PAIR(std::move(old_pairs[i]));
+        old_pairs[i].~PAIR();
+        m_num_pairs++;
+    }
+
+    delete [] old_ctrl;
+    ::operator delete(old_pairs);
+}
+
+template<typename KeyType, typename ValueType>
+void ExpandableHashMap<KeyType, ValueType>::Allocate(int size)
+{
+    m_size = size;
+    m_num_pairs = 0;
+    m_num_erased = 0;
+    m_ctrl = new int8_t[size];
+    memset(m_ctrl, EMPTY, size);
+    m_pairs = static_cast<PAIR*>(::operator new(sizeof(PAIR)*size));
+}
+
+template<typename KeyType, typename ValueType>
+void ExpandableHashMap<KeyType, ValueType>::DestroyPairs()
+{
+    for(int i = 0; i < m_size; i++)
+        if(m_ctrl[i] >= 0)
+            m_pairs[i].~PAIR();
+}
 
 #endif // EXPANDABLE_HASH_MAP
@@ -0,0 +1,68 @@
+//  Author:  Noah Himed
+//  Date:    16 October 2026
+//  Summary: A small, fast pseudo-random number generator for the hot
+//           loops of the delivery optimizer, seeded explicitly so runs
+//           can be repeated exactly.
+
+#ifndef FAST_RANDOM_INCLUDED
+#define FAST_RANDOM_INCLUDED
+
+#include <cstdint>
+
+// xoshiro256** by Blackman and Vigna: 32 bytes of state and a few shifts,
+// rotates and multiplies per number, where std::mt19937 keeps 5 KB of state.
+// Each object is meant for one thread, so it needs no locking.
+class FastRandom
+{
+public:
+    explicit FastRandom(std::uint64_t seed)
+    {
+        // spread the seed over the whole state with splitmix64, as the
+        // authors recommend, so similar seeds give unrelated sequences
+        for(int i = 0; i < 4; i++)
+        {
+            seed += 0x9E3779B97F4A7C15ull;
+            std::uint64_t z = seed;
+            z = (z ^ (z >> 30))*0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27))*0x94D049BB133111EBull;
+            m_state[i] = z ^ (z >> 31);
+        }
+    }
+
+    std::uint64_t Next()
+    {
+        const std::uint64_t result = Rotate(m_state[1]*5, 7)*9;
+        const std::uint64_t t = m_state[1] << 17;
+        m_state[2] ^= m_state[0];
+        m_state[3] ^= m_state[1];
+        m_state[1] ^= m_state[2];
+        m_state[0] ^= m_state[3];
+        m_state[2] ^= t;
+        m_state[3] = Rotate(m_state[3], 45);
+        return result;
+    }
+
+    // a number from 0 up to but not including bound, which must be positive;
+    // scaling the top 32 bits avoids a division and is unbiased enough for
+    // bounds far below 2^32
+    std::uint32_t Below(std::uint32_t bound)
+    {
+        return std::uint32_t(((Next() >> 32)*bound) >> 32);
+    }
+
+    // a number in [0, 1) with the full 53 bits of a double
+    double Uniform()
+    {
+        return double(Next() >> 11)*(1.0/9007199254740992.0);
+    }
+
+private:
+    static std::uint64_t Rotate(std::uint64_t x, int k)
+    {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    std::uint64_t m_state[4];
+};
+
+#endif // FAST_RANDOM_INCLUDED
@@ -0,0 +1,84 @@
+//  Author:  Noah Himed
+//  Date:    16 October 2026
+//  Summary: Implements the reusable per-thread search spaces used by
+//           the shortest path searches.
+
+#include "graph_search.h"
+
+#include <limits>
+
+using namespace std;
+
+SearchSpace::SearchSpace()
+: m_generation(0)
+{}
+
+void SearchSpace::Reset(NodeId num_nodes)
+{
+    m_queue.clear();
+    if(m_labels.size() < num_nodes)
+    {
+        Label unused = {0.0, NO_NODE, NO_EDGE, 0, false};
+        m_labels.resize(num_nodes, unused);
+    }
+
+    // stamp 0 is never a live generation, so on wrapping around every
+    // label has to be marked stale by hand, once every 4 billion searches
+    if(++m_generation == 0)
+    {
+        for(Label& label : m_labels)
+            label.stamp = 0;
+        m_generation = 1;
+    }
+}
+
+void shortestPathTree(const StreetMap& sm, NodeId source, vector<double>& dist,
+                      vector<NodeId>* parents, vector<NodeId>* settle_order,
+                      vector<EdgeId>* parent_edges)
+{
+    const NodeId num_nodes = sm.NodeCount();
+    dist.assign(num_nodes, numeric_limits<double>::infinity());
+    if(parents != nullptr)
+        parents->assign(num_nodes, NO_NODE);
+    if(settle_order != nullptr)
+        settle_order->clear();
+    if(parent_edges != nullptr)
+        parent_edges->assign(num_nodes, NO_EDGE);
+    if(source >= num_nodes)
+        return;
+
+    SearchSpace& search = threadSearchSpace(0);
+    search.Reset(num_nodes);
+    search.Update(source, 0, NO_NODE, NO_EDGE);
+    search.Push(source, 0);
+    while(!search.QueueEmpty())
+    {
+        NodeId node = search.PopMin();
+        if(search.Settled(node))
+            continue;
+        search.Settle(node);
+        dist[node] = search.Cost(node);
+        if(parents != nullptr)
+            (*parents)[node] = search.Parent(node);
+        if(settle_order != nullptr)
+            settle_order->push_back(node);
+        if(parent_edges != nullptr)
+            (*parent_edges)[node] = search.ParentEdge(node);
+
+        for(StreetEdge edge : sm.Neighbors(node))
+        {
+            double cost = search.Cost(node) + edge.length;
+            if(!search.Reached(edge.target) || cost < search.Cost(edge.target))
+            {
+                search.Update(edge.target, cost, node, edge.id);
+                search.Push(edge.target, cost);
+            }
+        }
+    }
+}
+
+SearchSpace& threadSearchSpace(int which)
+{
+    static thread_local SearchSpace spaces[2];
+    return spaces[which];
+}
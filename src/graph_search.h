@@ -0,0 +1,113 @@
+//  Author:  Noah Himed
+//  Date:    16 October 2026
+//  Summary: Scratch space shared by the shortest path searches over a
+//           StreetMap, reused from one query to the next so a search
+//           neither allocates nor clears per-node arrays.
+
+#ifndef GRAPH_SEARCH_INCLUDED
+#define GRAPH_SEARCH_INCLUDED
+
+#include "provided.h"
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+// marks a node or edge that doesn't exist, such as the parent of a source
+const NodeId NO_NODE = 0xFFFFFFFF;
+const EdgeId NO_EDGE = 0xFFFFFFFF;
+
+// Labels and a priority queue for one search direction. Every label carries
+// the generation it was written in, so starting a new search only bumps
+// the generation instead of touching each node.
+class SearchSpace
+{
+public:
+    SearchSpace();
+    // begins a new search over a graph of num_nodes nodes; this only
+    // allocates when the graph is larger than any searched before
+    void Reset(NodeId num_nodes);
+
+    bool Reached(NodeId node) const { return m_labels[node].stamp == m_generation; }
+    bool Settled(NodeId node) const { return Reached(node) && m_labels[node].settled; }
+    // the following are only meaningful for reached nodes
+    double Cost(NodeId node) const { return m_labels[node].cost; }
+    NodeId Parent(NodeId node) const { return m_labels[node].parent; }
+    EdgeId ParentEdge(NodeId node) const { return m_labels[node].edge; }
+
+    // records a new best cost for node, reached from parent along edge
+    void Update(NodeId node, double cost, NodeId parent, EdgeId edge)
+    {
+        Label& label = m_labels[node];
+        label.cost = cost;
+        label.parent = parent;
+        label.edge = edge;
+        label.stamp = m_generation;
+        label.settled = false;
+    }
+    void Settle(NodeId node) { m_labels[node].settled = true; }
+
+    // a min-heap of nodes by rank; nodes may be queued more than once, so
+    // callers skip entries for nodes they've already settled
+    void Push(NodeId node, double rank)
+    {
+        m_queue.emplace_back(rank, node);
+        std::push_heap(m_queue.begin(), m_queue.end(), std::greater<QueueEntry>());
+    }
+    bool QueueEmpty() const { return m_queue.empty(); }
+    double TopRank() const { return m_queue.front().first; }
+    NodeId PopMin()
+    {
+        NodeId node = m_queue.front().second;
+        std::pop_heap(m_queue.begin(), m_queue.end(), std::greater<QueueEntry>());
+        m_queue.pop_back();
+        return node;
+    }
+
+private:
+    struct Label
+    {
+        double cost;
+        NodeId parent;
+        EdgeId edge;
+        std::uint32_t stamp;
+        bool settled;
+    };
+    typedef std::pair<double, NodeId> QueueEntry;
+
+    std::vector<Label> m_labels;
+    std::vector<QueueEntry> m_queue;
+    std::uint32_t m_generation;
+};
+
+// The edge leading back along edge, which leaves the node from. Every
+// street segment is stored as an edge in each direction, so this always
+// exists; it's the one with the same street and length.
+inline EdgeId reverseEdge(const StreetMap& sm, NodeId from, EdgeId edge)
+{
+    std::uint32_t street = sm.EdgeStreet(edge);
+    double length = sm.EdgeLength(edge);
+    for(StreetEdge back : sm.Neighbors(sm.EdgeTarget(edge)))
+        if(back.target == from && back.street == street && back.length == length)
+            return back.id;
+    return NO_EDGE;
+}
+
+// Dijkstra from source over the whole map. Fills dist with each node's
+// distance from source, infinity for nodes it can't reach; parents, if
+// given, with the node each node is reached from (NO_NODE for source and
+// unreached nodes); settle_order, if given, with the reached nodes nearest
+// first; and parent_edges, if given, with the edge each node is reached
+// along (NO_EDGE where there's no parent).
+void shortestPathTree(const StreetMap& sm, NodeId source, std::vector<double>& dist,
+                      std::vector<NodeId>* parents = nullptr,
+                      std::vector<NodeId>* settle_order = nullptr,
+                      std::vector<EdgeId>* parent_edges = nullptr);
+
+// the calling thread's search spaces, kept for the life of the thread;
+// a search in one direction uses space 0, a search in both uses 0 and 1
+SearchSpace& threadSearchSpace(int which);
+
+#endif // GRAPH_SEARCH_INCLUDED
@@ -0,0 +1,168 @@
+//  Author:  Noah Himed
+//  Date:    16 October 2026
+//  Summary: Measures insert and lookup throughput of ExpandableHashMap
+//           against the chained hash map it replaced, keyed by every
+//           coordinate in a map data file.
+
+#include "provided.h"
+#include "expandable_hash_map.h"
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+unsigned int hasher(const FixedCoord& coord)
+{
+    return static_cast<unsigned int>(std::hash<uint64_t>()((uint64_t(uint32_t(coord.lat)) << 32) | uint32_t(coord.lon)));
+}
+
+// the previous ExpandableHashMap, which kept a heap-allocated list per bucket
+template<typename KeyType, typename ValueType>
+class ChainedHashMap
+{
+public:
+    ChainedHashMap(double max_load_factor = 0.5)
+    : m_map(8, nullptr), m_num_pairs(0), m_max_load(max_load_factor)
+    {}
+
+    ~ChainedHashMap()
+    {
+        for(auto bucket : m_map)
+            delete bucket;
+    }
+
+    void Associate(const KeyType& key, const ValueType& value)
+    {
+        if(AddPairToMap(m_map, key, value))
+        {
+            m_num_pairs++;
+            if(double(m_num_pairs)/double(m_map.size()) > m_max_load)
+            {
+                vector<list<PAIR>*> new_map(2*m_map.size(), nullptr);
+                for(auto bucket : m_map)
+                    if(bucket != nullptr)
+                        for(auto pair = bucket->begin(); pair != bucket->end(); pair++)
+                            AddPairToMap(new_map, pair->m_key, pair->m_val, true);
+                for(auto bucket : m_map)
+                    delete bucket;
+                m_map = new_map;
+            }
+        }
+    }
+
+    const ValueType* Find(const KeyType& key) const
+    {
+        unsigned int bucket_num = hasher(key) % m_map.size();
+        if(m_map[bucket_num] != nullptr)
+            for(auto bucket_it = m_map[bucket_num]->begin(); bucket_it != m_map[bucket_num]->end(); bucket_it++)
+                if(bucket_it->m_key == key)
+                    return &(bucket_it->m_val);
+        return nullptr;
+    }
+
+private:
+    struct PAIR
+    {
+        PAIR(KeyType key, ValueType val): m_key(key), m_val(val) {}
+        KeyType m_key;
+        ValueType m_val;
+    };
+
+    bool AddPairToMap(vector<list<PAIR>*>& map, KeyType key, ValueType val, bool copying=false)
+    {
+        unsigned int bucket_num = hasher(key) % map.size();
+        if(map[bucket_num] != nullptr)
+        {
+            if(!copying)
+                for(auto pair = map[bucket_num]->begin(); pair != map[bucket_num]->end(); pair++)
+                    if(key == pair->m_key)
+                    {
+                        pair->m_val = val;
+                        return false;
+                    }
+        }
+        else
+            map[bucket_num] = new list<PAIR>;
+        map[bucket_num]->push_back(PAIR(key, val));
+        return true;
+    }
+
+    vector<list<PAIR>*> m_map;
+    int m_num_pairs;
+    double m_max_load;
+};
+
+template<typename Function>
+double timeMs(Function f)
+{
+    auto start = chrono::steady_clock::now();
+    f();
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// inserts every key, then looks every key up (all hits) and every key
+// shifted off the map (all misses), each round times over
+template<typename Map>
+void runBenchmark(const string& name, const vector<FixedCoord>& keys, const vector<FixedCoord>& missing, int rounds)
+{
+    double insert_ms = 0, hit_ms = 0, miss_ms = 0;
+    long found = 0;
+    for(int round = 0; round < rounds; round++)
+    {
+        Map map;
+        insert_ms += timeMs([&]() {
+            for(size_t i = 0; i < keys.size(); i++)
+                map.Associate(keys[i], NodeId(i));
+        });
+        hit_ms += timeMs([&]() {
+            for(const FixedCoord& key : keys)
+                found += (map.Find(key) != nullptr);
+        });
+        miss_ms += timeMs([&]() {
+            for(const FixedCoord& key : missing)
+                found += (map.Find(key) != nullptr);
+        });
+    }
+
+    double num_ops = double(keys.size())*rounds / 1000.0;
+    cout.setf(ios::fixed);
+    cout.precision(1);
+    cout << name << ": insert " << num_ops/insert_ms << " Mops/s, hit lookup "
+         << num_ops/hit_ms << " Mops/s, miss lookup " << num_ops/miss_ms
+         << " Mops/s (" << found << " found)" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || argc > 3)
+    {
+        cout << "Usage: " << argv[0] << " mapdata.txt [rounds]" << endl;
+        return 1;
+    }
+
+    StreetMap sm;
+    if (!sm.load(argv[1]))
+    {
+        cout << "Unable to load map data file " << argv[1] << endl;
+        return 1;
+    }
+    int rounds = (argc == 3) ? stoi(argv[2]) : 50;
+
+    vector<FixedCoord> keys, missing;
+    for(NodeId node = 0; node < sm.NodeCount(); node++)
+    {
+        FixedCoord coord = sm.NodeFixedCoord(node);
+        keys.push_back(coord);
+        coord.lon += 1;
+        missing.push_back(coord);
+    }
+    cout << keys.size() << " coordinates, " << rounds << " rounds" << endl;
+
+    runBenchmark<ChainedHashMap<FixedCoord, NodeId>>("chained (previous)", keys, missing, rounds);
+    runBenchmark<ExpandableHashMap<FixedCoord, NodeId>>("open addressing   ", keys, missing, rounds);
+}
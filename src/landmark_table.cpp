@@ -0,0 +1,280 @@
+//  Author:  Noah Himed
+//  Date:    16 October 2026
+//  Summary: Chooses landmark nodes on a StreetMap and keeps their distances
+//           to every node, giving A* triangle inequality lower bounds.
+
+#include "provided.h"
+#include "graph_search.h"
+
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+
+using namespace std;
+
+// Stored distances are rounded to the nearest float, which can overstate a
+// difference of two by a few parts in a hundred million of their sum; the
+// bounds give back this much of the sum so they stay below the true distance.
+const double FLOAT_SLACK = 1e-6;
+
+// quantized distances are multiples of the table's scale below this; the
+// largest value marks nodes a landmark can't reach
+const uint16_t QUANTIZED_UNREACHABLE = 0xFFFF;
+
+class LandmarkTableImpl
+{
+public:
+    LandmarkTableImpl(const StreetMap* sm);
+    ~LandmarkTableImpl();
+    void Build(int num_landmarks, LandmarkSelection selection, bool quantized);
+    bool IsBuilt() const;
+    int LandmarkCount() const;
+    NodeId Landmark(int index) const;
+    double LowerBound(NodeId from, NodeId to) const;
+private:
+    // the node, other than an existing landmark, farthest from its nearest landmark
+    NodeId FarthestNode(const vector<vector<double>>& distances) const;
+    // Goldberg and Werneck's avoid rule: grow a shortest path tree from a
+    // random root, weigh each node by how much the current landmarks
+    // underestimate its distance from the root, and walk down the heaviest
+    // subtrees holding no landmark to a leaf
+    NodeId AvoidNode(const vector<vector<double>>& distances, minstd_rand& rng) const;
+
+    const StreetMap* m_sm_ptr;
+    vector<NodeId> m_landmarks;
+    bool m_quantized;
+    // each node's distances from every landmark, side by side so a bound
+    // reads one short run of memory per node
+    vector<float> m_distances;
+    vector<uint16_t> m_quantized_distances;
+    double m_scale;
+};
+
+LandmarkTableImpl::LandmarkTableImpl(const StreetMap* sm)
+: m_sm_ptr(sm), m_quantized(false), m_scale(0)
+{}
+
+LandmarkTableImpl::~LandmarkTableImpl()
+{}
+
+void LandmarkTableImpl::Build(int num_landmarks, LandmarkSelection selection, bool quantized)
+{
+    const NodeId num_nodes = m_sm_ptr->NodeCount();
+    m_landmarks.clear();
+    m_distances.clear();
+    m_quantized_distances.clear();
+    m_quantized = quantized;
+    m_scale = 0;
+    if(num_nodes == 0 || num_landmarks <= 0)
+        return;
+
+    // the distances from each landmark chosen so far, kept exact while building
+    vector<vector<double>> distances;
+    minstd_rand rng(num_nodes);
+    while(int(m_landmarks.size()) < num_landmarks && m_landmarks.size() < num_nodes)
+    {
+        NodeId landmark;
+        if(m_landmarks.empty() && selection == LANDMARKS_FARTHEST)
+        {
+            // start from the node farthest from an arbitrary one
+            vector<double> from_first;
+            shortestPathTree(*m_sm_ptr, 0, from_first);
+            distances.push_back(from_first);
+            landmark = FarthestNode(distances);
+            distances.clear();
+        }
+        else if(selection == LANDMARKS_AVOID)
+            landmark = AvoidNode(distances, rng);
+        else
+            landmark = FarthestNode(distances);
+        if(landmark == NO_NODE)
+            break;
+
+        m_landmarks.push_back(landmark);
+        distances.emplace_back();
+        shortestPathTree(*m_sm_ptr, landmark, distances.back());
+    }
+
+    const size_t num_chosen = m_landmarks.size();
+    if(!quantized)
+    {
+        m_distances.resize(num_nodes*num_chosen);
+        for(NodeId node = 0; node < num_nodes; node++)
+            for(size_t i = 0; i < num_chosen; i++)
+                m_distances[node*num_chosen + i] = float(distances[i][node]);
+        return;
+    }
+
+    double max_dist = 0;
+    for(const vector<double>& from_landmark : distances)
+        for(double dist : from_landmark)
+            if(!isinf(dist))
+                max_dist = max(max_dist, dist);
+    m_scale = (max_dist > 0 ? max_dist : 1.0) / (QUANTIZED_UNREACHABLE - 1);
+    m_quantized_distances.resize(num_nodes*num_chosen);
+    for(NodeId node = 0; node < num_nodes; node++)
+        for(size_t i = 0; i < num_chosen; i++)
+        {
+            double dist = distances[i][node];
+            m_quantized_distances[node*num_chosen + i] = isinf(dist) ? QUANTIZED_UNREACHABLE
+                : uint16_t(min(floor(dist / m_scale), double(QUANTIZED_UNREACHABLE - 1)));
+        }
+}
+
+NodeId LandmarkTableImpl::FarthestNode(const vector<vector<double>>& distances) const
+{
+    NodeId farthest = NO_NODE;
+    double farthest_dist = -1;
+    for(NodeId node = 0; node < m_sm_ptr->NodeCount(); node++)
+    {
+        double nearest = numeric_limits<double>::infinity();
+        for(const vector<double>& from_landmark : distances)
+            nearest = min(nearest, from_landmark[node]);
+        // nodes no landmark reaches are left to a landmark of their own
+        // only once every reachable node is covered
+        if(!isinf(nearest) && nearest > farthest_dist
+           && find(m_landmarks.begin(), m_landmarks.end(), node) == m_landmarks.end())
+        {
+            farthest = node;
+            farthest_dist = nearest;
+        }
+    }
+    return farthest;
+}
+
+NodeId LandmarkTableImpl::AvoidNode(const vector<vector<double>>& distances, minstd_rand& rng) const
+{
+    const StreetMap& sm = *m_sm_ptr;
+    const NodeId num_nodes = sm.NodeCount();
+    NodeId root = NodeId(rng() % num_nodes);
+    vector<double> dist;
+    vector<NodeId> parents;
+    vector<NodeId> order;
+    shortestPathTree(sm, root, dist, &parents, &order);
+
+    // add each node's weight into its parent's, children first; a subtree
+    // already holding a landmark is worth nothing
+    vector<double> size(num_nodes, 0.0);
+    vector<bool> has_landmark(num_nodes, false);
+    for(NodeId landmark : m_landmarks)
+        has_landmark[landmark] = true;
+    for(auto it = order.rbegin(); it != order.rend(); it++)
+    {
+        NodeId node = *it;
+        double bound = 0;
+        for(const vector<double>& from_landmark : distances)
+            if(!isinf(from_landmark[root]) && !isinf(from_landmark[node]))
+                bound = max(bound, fabs(from_landmark[root] - from_landmark[node]));
+        size[node] += dist[node] - bound;
+        if(has_landmark[node])
+            size[node] = 0;
+        if(node != root)
+        {
+            size[parents[node]] += size[node];
+            if(has_landmark[node])
+                has_landmark[parents[node]] = true;
+        }
+    }
+
+    NodeId node = root;
+    for(;;)
+    {
+        NodeId heaviest = NO_NODE;
+        for(StreetEdge edge : sm.Neighbors(node))
+            if(parents[edge.target] == node && size[edge.target] > 0
+               && (heaviest == NO_NODE || size[edge.target] > size[heaviest]))
+                heaviest = edge.target;
+        if(heaviest == NO_NODE)
+            break;
+        node = heaviest;
+    }
+    // a root with nothing left to cover falls back on the farthest node
+    if(node == root && !distances.empty())
+        return FarthestNode(distances);
+    return node;
+}
+
+bool LandmarkTableImpl::IsBuilt() const
+{
+    return !m_landmarks.empty();
+}
+
+int LandmarkTableImpl::LandmarkCount() const
+{
+    return int(m_landmarks.size());
+}
+
+NodeId LandmarkTableImpl::Landmark(int index) const
+{
+    return m_landmarks[index];
+}
+
+double LandmarkTableImpl::LowerBound(NodeId from, NodeId to) const
+{
+    // Distances are symmetric, so for every landmark L the shortest route
+    // between from and to is at least |d(L, to) - d(L, from)|.
+    const size_t num_landmarks = m_landmarks.size();
+    double bound = 0;
+    if(m_quantized)
+    {
+        // each stored value is its distance rounded down to a multiple of the
+        // scale, so a difference of k steps means at least k - 1 of them
+        const uint16_t* from_row = &m_quantized_distances[from*num_landmarks];
+        const uint16_t* to_row = &m_quantized_distances[to*num_landmarks];
+        int steps = 0;
+        for(size_t i = 0; i < num_landmarks; i++)
+            if(from_row[i] != QUANTIZED_UNREACHABLE && to_row[i] != QUANTIZED_UNREACHABLE)
+                steps = max(steps, abs(int(from_row[i]) - int(to_row[i])));
+        if(steps > 1)
+            bound = (steps - 1)*m_scale;
+        return bound;
+    }
+
+    const float* from_row = &m_distances[from*num_landmarks];
+    const float* to_row = &m_distances[to*num_landmarks];
+    for(size_t i = 0; i < num_landmarks; i++)
+    {
+        double a = from_row[i], b = to_row[i];
+        if(!isinf(a) && !isinf(b))
+            bound = max(bound, fabs(a - b) - (a + b)*FLOAT_SLACK);
+    }
+    return bound;
+}
+
+LandmarkTable::LandmarkTable(const StreetMap* sm)
+{
+    m_impl = new LandmarkTableImpl(sm);
+}
+
+LandmarkTable::~LandmarkTable()
+{
+    delete m_impl;
+}
+
+void LandmarkTable::Build(int num_landmarks, LandmarkSelection selection, bool quantized)
+{
+    m_impl->Build(num_landmarks, selection, quantized);
+}
+
+bool LandmarkTable::IsBuilt() const
+{
+    return m_impl->IsBuilt();
+}
+
+int LandmarkTable::LandmarkCount() const
+{
+    return m_impl->LandmarkCount();
+}
+
+NodeId LandmarkTable::Landmark(int index) const
+{
+    return m_impl->Landmark(index);
+}
+
+double LandmarkTable::LowerBound(NodeId from, NodeId to) const
+{
+    return m_impl->LowerBound(from, to);
+}
@@ -5,33 +5,101 @@
 
 
 #include "provided.h"
+#include "batch_planning.h"
+#include "delivery_io.h"
+#include "planning_server.h"
 
+#include <chrono>
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
+#include <cstdlib>
 
 using namespace std;
 
-bool loadDeliveryRequests(string deliveriesFile, GeoCoord& depot, vector<DeliveryRequest>& v);
-bool parseDelivery(string line, string& lat, string& lon, string& item);
+// how many legs --route-cache keeps the routes of
+const size_t ROUTE_CACHE_LEGS = 100000;
+// how often a server saves its route cache, so a restart starts warm
+const int ROUTE_CACHE_SAVE_SECONDS = 60;
 
 int main(int argc, char *argv[])
 {
-    if (argc != 3)
+    const char* program = argv[0];
+    // --route-cache keeps the routes of legs in a snapshot file between runs
+    string cache_file;
+    if (argc >= 3 && string(argv[1]) == "--route-cache")
     {
-        cout << "Usage: " << argv[0] << " mapdata.txt deliveries.txt" << endl;
+        cache_file = argv[2];
+        argc -= 2;
+        argv += 2;
+    }
+    // --serve keeps the map loaded and plans requests from a socket;
+    // --batch plans many deliveries files at once
+    const bool serve = (argc == 4 || argc == 5) && string(argv[1]) == "--serve";
+    const bool batch = argc >= 5 && string(argv[1]) == "--batch";
+    if (argc != 3 && !serve && !batch)
+    {
+        cout << "Usage: " << program << " [--route-cache snapshot] mapdata.txt deliveries.txt" << endl;
+        cout << "       " << program << " [--route-cache snapshot] --serve mapdata.txt socket [workers]" << endl;
+        cout << "       " << program << " [--route-cache snapshot] --batch mapdata.txt output_dir deliveries..." << endl;
         return 1;
     }
+    const char* map_file = (serve || batch) ? argv[2] : argv[1];
 
     StreetMap sm;
             
-    if (!sm.load(argv[1]))
+    if (!sm.load(map_file))
     {
-        cout << "Unable to load map data file " << argv[1] << endl;
+        cout << "Unable to load map data file " << map_file << endl;
         return 1;
     }
+
+    DeliveryPlanner dp(&sm);
+    RouteCache cache(&sm, ROUTE_CACHE_LEGS);
+    if (!cache_file.empty())
+    {
+        // a missing snapshot just means starting cold
+        cache.load(cache_file);
+        dp.SetRouteCache(&cache);
+    }
+
+    if (serve)
+    {
+        unsigned workers = (argc == 5) ? unsigned(atoi(argv[4])) : 0;
+        if (!cache_file.empty())
+            thread([&cache, cache_file]() {
+                for (;;)
+                {
+                    this_thread::sleep_for(chrono::seconds(ROUTE_CACHE_SAVE_SECONDS));
+                    cache.save(cache_file);
+                }
+            }).detach();
+        if (!runPlanningServer(dp, argv[3], workers))
+        {
+            cout << "Unable to serve on socket " << argv[3] << endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (batch)
+    {
+        vector<string> paths(argv + 4, argv + argc);
+        if (!runBatchPlanning(dp, paths, argv[3], cout))
+        {
+            cout << "No deliveries files could be planned into " << argv[3] << endl;
+            return 1;
+        }
+        if (!cache_file.empty())
+        {
+            RouteCacheStats stats = cache.Stats();
+            cout << "Route cache: " << stats.hits << " hits, " << stats.misses << " misses, "
+                 << stats.evictions << " evictions" << endl;
+            cache.save(cache_file);
+        }
+        return 0;
+    }
     
     GeoCoord depot;
     vector<DeliveryRequest> deliveries;
@@ -43,68 +111,11 @@ int main(int argc, char *argv[])
 
     cout << "Generating route...\n\n";
 
-    DeliveryPlanner dp(&sm);
     vector<DeliveryCommand> dcs;
     double totalMiles;
     DeliveryResult result = dp.GenerateDeliveryPlan(depot, deliveries, dcs, totalMiles);
-    if (result == BAD_COORD)
-    {
-        cout << "One or more depot or delivery coordinates are invalid." << endl;
-        return 1;
-    }
-    if (result == NO_ROUTE)
-    {
-        cout << "No route can be found to deliver all items." << endl;
-        return 1;
-    }
-    cout << "Starting at the depot...\n";
-    for (const auto& dc : dcs)
-        cout << dc.Description() << endl;
-    cout << "You are back at the depot and your deliveries are done!\n";
-    cout.setf(ios::fixed);
-    cout.precision(2);
-    cout << totalMiles << " miles travelled for all deliveries." << endl;
-}
-
-bool loadDeliveryRequests(string deliveriesFile, GeoCoord& depot, vector<DeliveryRequest>& v)
-{
-    ifstream inf(deliveriesFile);
-    if (!inf)
-        return false;
-    string lat;
-    string lon;
-    inf >> lat >> lon;
-    inf.ignore(10000, '\n');
-    depot = GeoCoord(lat, lon);
-    string line;
-    while (getline(inf, line))
-    {
-        string item;
-        if (parseDelivery(line, lat, lon, item))
-            v.push_back(DeliveryRequest(item, GeoCoord(lat, lon)));
-    }
-    return true;
-}
-
-bool parseDelivery(string line, string& lat, string& lon, string& item)
-{
-    const size_t colon = line.find(':');
-    if (colon == string::npos)
-    {
-        cout << "Missing colon in deliveries file line: " << line << endl;
-        return false;
-    }
-    istringstream iss(line.substr(0, colon));
-    if (!(iss >> lat >> lon))
-    {
-        cout << "Bad format in deliveries file line: " << line << endl;
-        return false;
-    }
-    item = line.substr(colon + 1);
-    if (item.empty())
-    {
-        cout << "Missing item in deliveries file line: " << line << endl;
-        return false;
-    }
-    return true;
+    writeDeliveryPlan(cout, result, dcs, totalMiles);
+    if (!cache_file.empty())
+        cache.save(cache_file);
+    return result == DELIVERY_SUCCESS ? 0 : 1;
 }
@@ -0,0 +1,162 @@
+//  Author:  Noah Himed
+//  Date:    16 October 2026
+//  Summary: Describes the on-disk layout of a compiled map file and
+//           provides the fixed-point coordinate and checksum helpers
+//           shared by the text loader, the compiler and the mmap loader.
+
+#ifndef MAP_FORMAT_INCLUDED
+#define MAP_FORMAT_INCLUDED
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+#include "provided.h"
+
+// Coordinates in the map data carry 7 decimal places, so FixedCoord stores
+// them as integers counting 1e-7 degrees. Longitudes up to +/-180 degrees
+// fit comfortably inside an int32_t at this scale.
+const int32_t COORD_SCALE = 10000000;
+const int COORD_DECIMALS = 7;
+
+// parses a decimal degree string such as "-118.4794734" starting at pos,
+// rounding anything past 7 decimal places; pos is left on the first
+// character that isn't part of the number
+inline bool parseFixedCoord(const char*& pos, const char* end, int32_t& value)
+{
+    bool negative = false;
+    if(pos != end && (*pos == '-' || *pos == '+'))
+        negative = (*pos++ == '-');
+
+    int64_t whole = 0, fraction = 0;
+    int num_digits = 0, num_decimals = 0;
+    bool round_up = false;
+    while(pos != end && *pos >= '0' && *pos <= '9')
+    {
+        whole = whole*10 + (*pos++ - '0');
+        if(++num_digits > 3)
+            return false;
+    }
+    if(pos != end && *pos == '.')
+    {
+        pos++;
+        while(pos != end && *pos >= '0' && *pos <= '9')
+        {
+            if(num_decimals < COORD_DECIMALS)
+                fraction = fraction*10 + (*pos - '0');
+            else if(num_decimals == COORD_DECIMALS)
+                round_up = (*pos >= '5');
+            num_decimals++;
+            num_digits++;
+            pos++;
+        }
+    }
+    if(num_digits == 0)
+        return false;
+    for(int i = num_decimals; i < COORD_DECIMALS; i++)
+        fraction *= 10;
+
+    int64_t scaled = whole*COORD_SCALE + fraction + (round_up ? 1 : 0);
+    if(scaled > 180LL*COORD_SCALE)
+        return false;
+    value = static_cast<int32_t>(negative ? -scaled : scaled);
+    return true;
+}
+
+inline bool parseFixedCoord(const std::string& text, int32_t& value)
+{
+    const char* pos = text.data();
+    const char* end = pos + text.size();
+    return parseFixedCoord(pos, end, value) && pos == end;
+}
+
+// formats a fixed-point coordinate back into the 7 decimal place text
+// used by the map data files
+inline std::string fixedCoordText(int32_t value)
+{
+    char buffer[16];
+    char* pos = buffer + sizeof(buffer);
+    int64_t magnitude = value < 0 ? -int64_t(value) : int64_t(value);
+    for(int i = 0; i < COORD_DECIMALS; i++)
+    {
+        *--pos = char('0' + magnitude % 10);
+        magnitude /= 10;
+    }
+    *--pos = '.';
+    do
+    {
+        *--pos = char('0' + magnitude % 10);
+        magnitude /= 10;
+    } while(magnitude != 0);
+    if(value < 0)
+        *--pos = '-';
+    return std::string(pos, buffer + sizeof(buffer));
+}
+
+inline double fixedCoordDegrees(int32_t value)
+{
+    return double(value) / COORD_SCALE;
+}
+
+// 64-bit FNV-1a, folded a word at a time so that verifying a compiled map
+// runs at memory speed
+inline uint64_t mapChecksum(const void* data, size_t num_bytes)
+{
+    const uint64_t prime = 1099511628211ULL;
+    uint64_t hash = 14695981039346656037ULL;
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    size_t i = 0;
+    for(; i + sizeof(uint64_t) <= num_bytes; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * prime;
+    }
+    for(; i < num_bytes; i++)
+        hash = (hash ^ bytes[i]) * prime;
+    return hash;
+}
+
+// Layout of a compiled map file. The header is followed by the sections
+// below, each starting on an 8 byte boundary at the recorded offset
+// (measured from the start of the file):
+//
+//   nodes         FixedCoord[num_nodes], sorted by (lat, lon); a node's
+//                 id is its index in this table
+//   edge_offsets  uint32_t[num_nodes + 1], CSR row offsets into the
+//                 edge arrays
+//   edge_targets  uint32_t[num_edges], node each edge leads to
+//   edge_lengths  double[num_edges], length of each edge in miles
+//   edge_names    uint32_t[num_edges], street name index of each edge
+//   name_offsets  uint32_t[num_names + 1], offsets into the name bytes
+//   names         char[name_bytes], street names back to back
+//
+// The file is written in the host's byte order; endian_tag lets a loader
+// on a different architecture reject it instead of misreading it.
+const char COMPILED_MAP_MAGIC[8] = {'D', 'N', 'M', 'A', 'P', 'B', 'I', 'N'};
+const uint32_t COMPILED_MAP_VERSION = 2;
+const uint32_t COMPILED_MAP_ENDIAN_TAG = 0x01020304;
+
+struct CompiledMapHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t endian_tag;
+    uint32_t header_size;
+    uint32_t num_nodes;
+    uint32_t num_edges;
+    uint32_t num_names;
+    uint64_t name_bytes;
+    uint64_t file_size;
+    uint64_t checksum;      // mapChecksum of every byte after the header
+    uint64_t nodes_offset;
+    uint64_t edge_offsets_offset;
+    uint64_t edge_targets_offset;
+    uint64_t edge_lengths_offset;
+    uint64_t edge_names_offset;
+    uint64_t name_offsets_offset;
+    uint64_t names_offset;
+};
+
+#endif // MAP_FORMAT_INCLUDED
@@ -0,0 +1,148 @@
+//  Author:  Noah Himed
+//  Date:    16 October 2026
+//  Summary: Sends a deliveries file to a running planning server, either
+//           once to print its plan or many times to measure throughput.
+
+#include "planning_protocol.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+using namespace std;
+
+// prints a response the way delivery_navigator prints its plan
+static int printResponse(const string& response)
+{
+    istringstream in(response);
+    string status;
+    in >> status;
+    if (status == "BAD_COORD")
+    {
+        cout << "One or more depot or delivery coordinates are invalid." << endl;
+        return 1;
+    }
+    if (status == "NO_ROUTE")
+    {
+        cout << "No route can be found to deliver all items." << endl;
+        return 1;
+    }
+    if (status != "SUCCESS")
+    {
+        cout << "The server couldn't read the deliveries file." << endl;
+        return 1;
+    }
+    double totalMiles;
+    in >> totalMiles;
+    in.ignore(10000, '\n');
+    cout << "Starting at the depot...\n";
+    string line;
+    while (getline(in, line))
+        cout << line << endl;
+    cout << "You are back at the depot and your deliveries are done!\n";
+    cout.setf(ios::fixed);
+    cout.precision(2);
+    cout << totalMiles << " miles travelled for all deliveries." << endl;
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3 || argc > 5)
+    {
+        cout << "Usage: " << argv[0] << " socket deliveries.txt [requests [connections]]" << endl;
+        return 1;
+    }
+    ifstream inf(argv[2], ios::binary);
+    if (!inf)
+    {
+        cout << "Unable to load delivery request file " << argv[2] << endl;
+        return 1;
+    }
+    ostringstream text;
+    text << inf.rdbuf();
+    const string request = text.str();
+    const int num_requests = (argc >= 4) ? max(1, atoi(argv[3])) : 1;
+    const int num_connections = (argc == 5) ? max(1, min(atoi(argv[4]), num_requests)) : 1;
+
+    if (argc == 3)
+    {
+        int fd = connectToSocket(argv[1]);
+        if (fd < 0)
+        {
+            cout << "Unable to connect to " << argv[1] << endl;
+            return 1;
+        }
+        string response;
+        bool ok = writeFrame(fd, request) && readFrame(fd, response);
+        close(fd);
+        if (!ok)
+        {
+            cout << "The server closed the connection." << endl;
+            return 1;
+        }
+        return printResponse(response);
+    }
+
+    // each connection sends its share of the requests one after another,
+    // timing each from send to reply
+    vector<vector<double>> latencies(num_connections);
+    atomic<int> failures(0);
+    vector<thread> clients;
+    auto start = chrono::steady_clock::now();
+    for (int c = 0; c < num_connections; c++)
+        clients.emplace_back([&, c]() {
+            int share = num_requests / num_connections + (c < num_requests % num_connections ? 1 : 0);
+            int fd = connectToSocket(argv[1]);
+            if (fd < 0)
+            {
+                failures += share;
+                return;
+            }
+            string response;
+            for (int i = 0; i < share; i++)
+            {
+                auto sent = chrono::steady_clock::now();
+                if (!writeFrame(fd, request) || !readFrame(fd, response))
+                {
+                    failures += share - i;
+                    break;
+                }
+                if (response.compare(0, 7, "SUCCESS") != 0)
+                    failures++;
+                latencies[c].push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - sent).count());
+            }
+            close(fd);
+        });
+    for (thread& client : clients)
+        client.join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    vector<double> all;
+    for (const vector<double>& l : latencies)
+        all.insert(all.end(), l.begin(), l.end());
+    sort(all.begin(), all.end());
+    cout.setf(ios::fixed);
+    cout.precision(2);
+    cout << num_requests << " requests over " << num_connections << " connections in "
+         << seconds << " s: " << all.size() / seconds << " requests/s" << endl;
+    if (!all.empty())
+    {
+        double mean = 0;
+        for (double ms : all)
+            mean += ms;
+        mean /= all.size();
+        cout << "latency ms: mean " << mean << ", p50 " << all[all.size() / 2]
+             << ", p99 " << all[min(all.size() - 1, all.size() * 99 / 100)] << endl;
+    }
+    cout << failures << " failed" << endl;
+    return failures == 0 ? 0 : 1;
+}
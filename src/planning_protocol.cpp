@@ -0,0 +1,144 @@
+//  Author:  Noah Himed
+//  Date:    16 October 2026
+//  Summary: Implements framed messages over Unix domain sockets.
+
+#include "planning_protocol.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+// reads exactly size bytes, retrying short and interrupted reads
+static bool readFully(int fd, char* data, size_t size)
+{
+    while(size > 0)
+    {
+        ssize_t num_read = read(fd, data, size);
+        if(num_read < 0 && errno == EINTR)
+            continue;
+        if(num_read <= 0)
+            return false;
+        data += num_read;
+        size -= size_t(num_read);
+    }
+    return true;
+}
+
+// writes exactly size bytes; a peer that has gone away gives an error
+// rather than killing the process with SIGPIPE
+static bool writeFully(int fd, const char* data, size_t size)
+{
+    while(size > 0)
+    {
+        ssize_t num_written = send(fd, data, size, MSG_NOSIGNAL);
+        if(num_written < 0 && errno == EINTR)
+            continue;
+        if(num_written <= 0)
+            return false;
+        data += num_written;
+        size -= size_t(num_written);
+    }
+    return true;
+}
+
+// the payload size given by a frame's 4-byte header
+static uint32_t frameSize(const unsigned char* header)
+{
+    return (uint32_t(header[0]) << 24) | (uint32_t(header[1]) << 16)
+        | (uint32_t(header[2]) << 8) | uint32_t(header[3]);
+}
+
+bool readFrame(int fd, string& payload)
+{
+    unsigned char header[4];
+    if(!readFully(fd, reinterpret_cast<char*>(header), sizeof(header)))
+        return false;
+    uint32_t size = frameSize(header);
+    if(size > MAX_FRAME_BYTES)
+        return false;
+    payload.resize(size);
+    return size == 0 || readFully(fd, &payload[0], size);
+}
+
+bool takeFrame(string& buffer, string& payload, bool& oversized)
+{
+    oversized = false;
+    if(buffer.size() < 4)
+        return false;
+    uint32_t size = frameSize(reinterpret_cast<const unsigned char*>(buffer.data()));
+    oversized = (size > MAX_FRAME_BYTES);
+    if(oversized || buffer.size() - 4 < size)
+        return false;
+    payload.assign(buffer, 4, size);
+    buffer.erase(0, 4 + size_t(size));
+    return true;
+}
+
+bool writeFrame(int fd, const string& payload)
+{
+    if(payload.size() > MAX_FRAME_BYTES)
+        return false;
+    uint32_t size = uint32_t(payload.size());
+    // one write for the header and payload, so a small frame goes out in
+    // one packet
+    string frame(4, '\0');
+    frame[0] = char(size >> 24);
+    frame[1] = char(size >> 16);
+    frame[2] = char(size >> 8);
+    frame[3] = char(size);
+    frame += payload;
+    return writeFully(fd, frame.data(), frame.size());
+}
+
+// fills in the address of the socket at path; false if the path is too long
+static bool socketAddress(const string& path, sockaddr_un& address)
+{
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(path.empty() || path.size() >= sizeof(address.sun_path))
+        return false;
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+int listenOnSocket(const string& path)
+{
+    sockaddr_un address;
+    if(!socketAddress(path, address))
+        return -1;
+    // only ever remove a socket, never a file that happens to have the name
+    struct stat existing;
+    if(lstat(path.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode))
+        unlink(path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0)
+        return -1;
+    if(bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int connectToSocket(const string& path)
+{
+    sockaddr_un address;
+    if(!socketAddress(path, address))
+        return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0)
+        return -1;
+    if(connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
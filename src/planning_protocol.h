@@ -0,0 +1,42 @@
+//  Author:  Noah Himed
+//  Date:    16 October 2026
+//  Summary: The framing and sockets shared by the planning server and its
+//           client.
+//
+//  Client and server talk over a Unix domain stream socket in frames: a
+//  4-byte big-endian length, then that many bytes. A client sends any
+//  number of requests on one connection, each answered in turn.
+//
+//  A request is the text of a deliveries file: the depot, then one
+//  delivery per line.
+//
+//  A response is text too. Its first line is SUCCESS followed by the
+//  total miles travelled, then one line per command of the plan. Otherwise
+//  the first line is BAD_COORD, NO_ROUTE or BAD_REQUEST (the depot
+//  couldn't be read), and nothing follows.
+
+#ifndef PLANNING_PROTOCOL_INCLUDED
+#define PLANNING_PROTOCOL_INCLUDED
+
+#include <cstdint>
+#include <string>
+
+// frames longer than this are refused rather than allocated for
+const std::uint32_t MAX_FRAME_BYTES = 64u << 20;
+
+// false at the end of the stream, on an error, or for an oversized frame
+bool readFrame(int fd, std::string& payload);
+bool writeFrame(int fd, const std::string& payload);
+// Takes the first whole frame off the front of buffer, which holds bytes
+// as they arrived from a socket, for readers that can't block on one
+// connection. False if there's no whole frame yet, or if the next one is
+// oversized, which sets oversized.
+bool takeFrame(std::string& buffer, std::string& payload, bool& oversized);
+
+// Returns a socket listening at path, replacing any socket file left there
+// by an earlier server, or -1 on failure.
+int listenOnSocket(const std::string& path);
+// Returns a socket connected to the server at path, or -1 on failure.
+int connectToSocket(const std::string& path);
+
+#endif // PLANNING_PROTOCOL_INCLUDED
@@ -0,0 +1,284 @@
+//  Author:  Noah Himed
+//  Date:    16 October 2026
+//  Summary: Implements the planning server's worker threads and its
+//           handling of each request.
+
+#include "planning_server.h"
+#include "delivery_io.h"
+#include "planning_protocol.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+using namespace std;
+
+// the response to one request, a deliveries file's text
+static string planResponse(const DeliveryPlanner& planner, const string& request)
+{
+    istringstream in(request);
+    GeoCoord depot;
+    vector<DeliveryRequest> deliveries;
+    // bad delivery lines are skipped, as they are from a file
+    ostringstream warnings;
+    if(!readDeliveryRequests(in, depot, deliveries, warnings))
+        return "BAD_REQUEST\n";
+
+    vector<DeliveryCommand> commands;
+    double total_miles;
+    DeliveryResult result = planner.GenerateDeliveryPlan(depot, deliveries, commands, total_miles);
+    if(result == BAD_COORD)
+        return "BAD_COORD\n";
+    if(result == NO_ROUTE)
+        return "NO_ROUTE\n";
+    ostringstream response;
+    response << "SUCCESS " << fixed << setprecision(6) << total_miles << '\n';
+    for(const DeliveryCommand& command : commands)
+        response << command.Description() << '\n';
+    return response.str();
+}
+
+// a client that stops reading its responses for this long is dropped,
+// rather than keeping a worker blocked writing to it
+const int WRITE_TIMEOUT_SECONDS = 30;
+
+// while the process is out of descriptors or memory, new connections wait
+// in the listen backlog until one closes or this long has passed
+const int ACCEPT_PAUSE_MS = 1000;
+
+// whether a failed accept or poll only means the process is short of a
+// resource for now, rather than that the listening socket is unusable
+static bool outOfResources(int error)
+{
+    return error == EMFILE || error == ENFILE || error == ENOBUFS || error == ENOMEM;
+}
+
+namespace
+{
+    // A connection as the polling thread sees it: the bytes read from it
+    // that aren't yet a whole request, and whether a worker has one of its
+    // requests. A busy connection isn't polled, so its requests are
+    // answered one at a time and in order.
+    struct Connection
+    {
+        string buffer;
+        bool busy;
+    };
+
+    // a request read off a connection, waiting for a worker
+    struct QueuedRequest
+    {
+        int fd;
+        string request;
+    };
+
+    // a connection a worker is done with, handed back to the polling thread
+    struct Finished
+    {
+        int fd;
+        bool ok;    // false if the response couldn't be written
+    };
+}
+
+bool runPlanningServer(const DeliveryPlanner& planner, const string& socketPath, unsigned numWorkers)
+{
+    int listen_fd = listenOnSocket(socketPath);
+    if(listen_fd < 0)
+        return false;
+    // workers wake the polling thread through this pipe when they finish
+    int wake_fds[2];
+    if(pipe(wake_fds) != 0)
+    {
+        close(listen_fd);
+        return false;
+    }
+    fcntl(wake_fds[0], F_SETFL, O_NONBLOCK);
+    if(numWorkers == 0)
+        numWorkers = max(1u, thread::hardware_concurrency());
+
+    mutex lock;
+    condition_variable request_ready;
+    deque<QueuedRequest> requests;
+    vector<Finished> finished;
+    bool stopping = false;
+
+    // Workers only ever block planning a request or writing its response,
+    // so they're threads of their own rather than tasks on the shared pool,
+    // which the planning itself uses.
+    vector<thread> workers;
+    for(unsigned i = 0; i < numWorkers; i++)
+        workers.emplace_back([&]() {
+            for(;;)
+            {
+                QueuedRequest queued;
+                {
+                    unique_lock<mutex> guard(lock);
+                    request_ready.wait(guard, [&]() { return stopping || !requests.empty(); });
+                    if(requests.empty())
+                        return;
+                    queued = move(requests.front());
+                    requests.pop_front();
+                }
+                bool ok = writeFrame(queued.fd, planResponse(planner, queued.request));
+                {
+                    lock_guard<mutex> guard(lock);
+                    finished.push_back(Finished{queued.fd, ok});
+                }
+                char wake = 0;
+                while(write(wake_fds[1], &wake, 1) < 0 && errno == EINTR)
+                    ;
+            }
+        });
+    cout << "Serving delivery plans on " << socketPath << " with " << numWorkers << " workers" << endl;
+
+    map<int, Connection> connections;
+    // queues the connection's next request if a whole one has arrived,
+    // and drops it if what arrived can't be a request
+    auto take_request = [&](int fd, Connection& connection) {
+        QueuedRequest queued;
+        bool oversized;
+        if(takeFrame(connection.buffer, queued.request, oversized))
+        {
+            queued.fd = fd;
+            connection.busy = true;
+            lock_guard<mutex> guard(lock);
+            requests.push_back(move(queued));
+            request_ready.notify_one();
+        }
+        return !oversized;
+    };
+    // Out of descriptors or memory, the listening socket is left out of
+    // the poll for a while rather than failing every accept in a loop.
+    bool accepting = true;
+    bool reported_pause = false;
+    chrono::steady_clock::time_point paused_at;
+    auto drop = [&](int fd) {
+        close(fd);
+        connections.erase(fd);
+        accepting = true;
+    };
+
+    bool failed = false;
+    vector<pollfd> polled;
+    vector<char> chunk(1 << 16);
+    while(!failed)
+    {
+        if(!accepting && chrono::steady_clock::now() - paused_at >= chrono::milliseconds(ACCEPT_PAUSE_MS))
+            accepting = true;
+        polled.clear();
+        // poll skips negative descriptors
+        polled.push_back(pollfd{accepting ? listen_fd : -1, POLLIN, 0});
+        polled.push_back(pollfd{wake_fds[0], POLLIN, 0});
+        for(const auto& entry : connections)
+            if(!entry.second.busy)
+                polled.push_back(pollfd{entry.first, POLLIN, 0});
+        if(poll(polled.data(), polled.size(), accepting ? -1 : ACCEPT_PAUSE_MS) < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            if(outOfResources(errno))
+            {
+                this_thread::sleep_for(chrono::milliseconds(ACCEPT_PAUSE_MS));
+                continue;
+            }
+            cerr << "Planning server: poll failed: " << strerror(errno) << endl;
+            failed = true;
+            break;
+        }
+
+        if(polled[1].revents != 0)
+        {
+            char drained[64];
+            while(read(wake_fds[0], drained, sizeof(drained)) > 0)
+                ;
+            vector<Finished> done;
+            {
+                lock_guard<mutex> guard(lock);
+                done.swap(finished);
+            }
+            for(const Finished& f : done)
+            {
+                Connection& connection = connections[f.fd];
+                connection.busy = false;
+                if(!f.ok || !take_request(f.fd, connection))
+                    drop(f.fd);
+            }
+        }
+
+        for(size_t i = 2; i < polled.size(); i++)
+        {
+            if(polled[i].revents == 0)
+                continue;
+            const int fd = polled[i].fd;
+            ssize_t num_read = recv(fd, chunk.data(), chunk.size(), MSG_DONTWAIT);
+            if(num_read < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+                continue;
+            if(num_read <= 0)
+            {
+                drop(fd);
+                continue;
+            }
+            Connection& connection = connections[fd];
+            connection.buffer.append(chunk.data(), size_t(num_read));
+            if(!take_request(fd, connection))
+                drop(fd);
+        }
+
+        if(polled[0].revents != 0)
+        {
+            int fd = accept(listen_fd, nullptr, nullptr);
+            if(fd < 0)
+            {
+                if(outOfResources(errno))
+                {
+                    if(!reported_pause)
+                        cerr << "Planning server: " << strerror(errno) << ", pausing new connections" << endl;
+                    reported_pause = true;
+                    accepting = false;
+                    paused_at = chrono::steady_clock::now();
+                }
+                else if(errno == EBADF || errno == EINVAL || errno == ENOTSOCK || errno == EFAULT)
+                {
+                    cerr << "Planning server: accept failed: " << strerror(errno) << endl;
+                    failed = true;
+                }
+                // anything else, such as a client giving up before it was
+                // accepted or a network error Linux passes on, only loses
+                // that one connection
+                continue;
+            }
+            reported_pause = false;
+            timeval timeout = {WRITE_TIMEOUT_SECONDS, 0};
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            connections[fd] = Connection{string(), false};
+        }
+    }
+
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    request_ready.notify_all();
+    for(thread& worker : workers)
+        worker.join();
+    for(const auto& entry : connections)
+        close(entry.first);
+    close(wake_fds[0]);
+    close(wake_fds[1]);
+    close(listen_fd);
+    return !failed;
+}
@@ -0,0 +1,25 @@
+//  Author:  Noah Himed
+//  Date:    16 October 2026
+//  Summary: A long-running server that plans deliveries over a map it
+//           loads once, for requests arriving on a Unix domain socket.
+
+#ifndef PLANNING_SERVER_INCLUDED
+#define PLANNING_SERVER_INCLUDED
+
+#include "provided.h"
+
+#include <string>
+
+// Serves plans made by planner at socketPath, speaking the protocol
+// described in planning_protocol.h, until the process is killed. The
+// calling thread waits on the socket and every open connection at once,
+// and queues each whole request it reads for numWorkers threads (0 for one
+// per core) to plan, so many plans are worked on at once and a connection
+// only holds a worker while one of its requests is being planned. The
+// workers all share planner, along with its map and any route cache.
+// Running short of descriptors or memory only pauses accepting new
+// connections for a while. Returns false if the socket can't be opened,
+// or if it later fails for good.
+bool runPlanningServer(const DeliveryPlanner& planner, const std::string& socketPath, unsigned numWorkers);
+
+#endif // PLANNING_SERVER_INCLUDED
@@ -4,11 +4,12 @@
 //           an optimal route between two given coordinates
 
 #include "provided.h"
-#include "expandable_hash_map.h"
+#include "graph_search.h"
 
 #include <list>
-#include <queue>
-#include <set>
+#include <vector>
+#include <algorithm>
+#include <atomic>
 #include <functional>
 
 using namespace std;
@@ -16,57 +17,55 @@ using namespace std;
 class PointToPointRouterImpl
 {
 public:
-    PointToPointRouterImpl(const StreetMap* sm);
+    PointToPointRouterImpl(const StreetMap* sm, RouteAlgorithm algorithm,
+                           const ContractionHierarchy* ch, const LandmarkTable* landmarks);
     ~PointToPointRouterImpl();
     DeliveryResult GeneratePointToPointRoute(
         const GeoCoord& start,
         const GeoCoord& end,
         list<StreetSegment>& route,
         double& total_dist_travelled) const;
+    DeliveryResult GenerateNodeRoute(
+        NodeId start,
+        NodeId end,
+        vector<EdgeId>& route,
+        double& total_dist_travelled) const;
+    void SetRouteCache(RouteCache* cache);
+    RouterStats Stats() const;
+    void ResetStats();
 private:
-    // defines a priority queue that sorts by value
-    // instead of key as a minheap
-    struct MinheapQueue
-    {
-        typedef pair<double, GeoCoord> pos;
-        priority_queue<pos, vector<pos>, greater<pos>> PosQueue;
-        
-        inline bool IsEmpty() const
-        {
-            return PosQueue.empty();
-        }
-        
-        inline void Insert(GeoCoord coord, double rank)
-        {
-            PosQueue.emplace(rank, coord);
-        }
-        
-        inline void PopTop()
-        {
-            PosQueue.pop();
-        }
-        
-        GeoCoord GetTopPos()
-        {
-            return PosQueue.top().second;
-        }
-        
-    };
-    
-    // pairs GeoCoord objects with street names
-    struct StreetPair
-    {
-        StreetPair(GeoCoord coord, string name=""): m_coord(coord), m_name(name) {}
-        GeoCoord m_coord;
-        string m_name;
-    };
-    
+    // the search itself, without the cache
+    DeliveryResult SearchNodeRoute(NodeId start, NodeId end, vector<EdgeId>& route,
+                                   double& total_dist_travelled, unsigned long& num_settled) const;
+    // A* forward from start; returns true if a route was found
+    bool SearchForward(NodeId start, NodeId end, vector<EdgeId>& route,
+                       double& total_dist_travelled, unsigned long& num_settled) const;
+    // A* from start and end at once; returns true if a route was found
+    bool SearchBidirectional(NodeId start, NodeId end, vector<EdgeId>& route,
+                             double& total_dist_travelled, unsigned long& num_settled) const;
+
     const StreetMap *m_street_map_ptr;
+    RouteAlgorithm m_algorithm;
+    // only set when routing with ROUTE_CONTRACTION_HIERARCHY
+    const ContractionHierarchy* m_ch;
+    // only set when routing with ROUTE_LANDMARK_ASTAR
+    const LandmarkTable* m_landmarks;
+    // routes already found, if the router was given a cache
+    RouteCache* m_cache;
+    // queries may run concurrently, so the totals are atomic
+    mutable atomic<unsigned long long> m_queries;
+    mutable atomic<unsigned long long> m_nodes_settled;
 };
 
-PointToPointRouterImpl::PointToPointRouterImpl(const StreetMap* sm)
+PointToPointRouterImpl::PointToPointRouterImpl(const StreetMap* sm, RouteAlgorithm algorithm,
+                                               const ContractionHierarchy* ch, const LandmarkTable* landmarks)
+: m_queries(0), m_nodes_settled(0)
 {
     m_street_map_ptr = sm;
+    m_algorithm = algorithm;
+    m_ch = ch;
+    m_landmarks = landmarks;
+    m_cache = nullptr;
 }
 
 PointToPointRouterImpl::~PointToPointRouterImpl()
@@ -78,87 +77,247 @@ DeliveryResult PointToPointRouterImpl::GeneratePointToPointRoute(
         list<StreetSegment>& route,
         double& total_dist_travelled) const
 {
-    vector<StreetSegment> segs;
     route.clear();
     total_dist_travelled = 0.0;
     
-    if(!(m_street_map_ptr->GetSegmentsThatStartWith(end, segs))
-       || !(m_street_map_ptr->GetSegmentsThatStartWith(start, segs)))
+    NodeId start_node, end_node;
+    if(!(m_street_map_ptr->FindNode(end, end_node))
+       || !(m_street_map_ptr->FindNode(start, start_node)))
         return BAD_COORD;
+    
+    vector<EdgeId> edges;
+    DeliveryResult result = GenerateNodeRoute(start_node, end_node, edges, total_dist_travelled);
+    
+    // turn the edges followed back into street segments
+    GeoCoord segStart = m_street_map_ptr->NodeCoord(start_node);
+    for(EdgeId edge: edges)
+    {
+        GeoCoord segEnd = m_street_map_ptr->NodeCoord(m_street_map_ptr->EdgeTarget(edge));
+        route.emplace_back(segStart, segEnd, m_street_map_ptr->StreetName(m_street_map_ptr->EdgeStreet(edge)));
+        segStart = segEnd;
+    }
+    return result;
+}
+
+DeliveryResult PointToPointRouterImpl::GenerateNodeRoute(
+        NodeId start,
+        NodeId end,
+        vector<EdgeId>& route,
+        double& total_dist_travelled) const
+{
+    route.clear();
+    total_dist_travelled = 0.0;
+    
+    NodeId num_nodes = m_street_map_ptr->NodeCount();
+    if(start >= num_nodes || end >= num_nodes)
+        return BAD_COORD;
+    
+    // a cached route costs no search, so it counts as a query settling nothing
+    DeliveryResult result;
+    if(m_cache != nullptr && m_cache->Lookup(start, end, route, total_dist_travelled, result))
+    {
+        m_queries++;
+        return result;
+    }
+    unsigned long num_settled = 0;
+    result = SearchNodeRoute(start, end, route, total_dist_travelled, num_settled);
+    m_queries++;
+    m_nodes_settled += num_settled;
+    if(m_cache != nullptr)
+        m_cache->Insert(start, end, route, total_dist_travelled, result);
+    return result;
+}
+
+DeliveryResult PointToPointRouterImpl::SearchNodeRoute(NodeId start, NodeId end, vector<EdgeId>& route,
+                                                       double& total_dist_travelled, unsigned long& num_settled) const
+{
+    if(m_algorithm == ROUTE_CONTRACTION_HIERARCHY)
+    {
+        if(m_ch == nullptr || !m_ch->IsBuilt())
+            return BAD_COORD;
+        return m_ch->GenerateNodeRoute(start, end, route, total_dist_travelled, &num_settled);
+    }
+    if(m_algorithm == ROUTE_LANDMARK_ASTAR && (m_landmarks == nullptr || !m_landmarks->IsBuilt()))
+        return BAD_COORD;
+    bool route_found;
+    if(m_algorithm == ROUTE_BIDIRECTIONAL_ASTAR)
+        route_found = SearchBidirectional(start, end, route, total_dist_travelled, num_settled);
     else
+        route_found = SearchForward(start, end, route, total_dist_travelled, num_settled);
+    return route_found ? DELIVERY_SUCCESS : NO_ROUTE;
+}
+
+void PointToPointRouterImpl::SetRouteCache(RouteCache* cache)
+{
+    m_cache = cache;
+}
+
+RouterStats PointToPointRouterImpl::Stats() const
+{
+    RouterStats stats;
+    stats.queries = m_queries;
+    stats.nodesSettled = m_nodes_settled;
+    return stats;
+}
+
+void PointToPointRouterImpl::ResetStats()
+{
+    m_queries = 0;
+    m_nodes_settled = 0;
+}
+
+bool PointToPointRouterImpl::SearchForward(NodeId start, NodeId end, vector<EdgeId>& route,
+                                           double& total_dist_travelled, unsigned long& num_settled) const
+{
+    // Utilization of the A* algorithm, keeping its per-node costs and back
+    // pointers in this thread's reusable search space
+    bool route_found = false;
+    double next_move_cost;
+    SearchSpace& search_space = threadSearchSpace(0);
+    search_space.Reset(m_street_map_ptr->NodeCount());
+    const FixedCoord end_coord = m_street_map_ptr->NodeFixedCoord(end);
+    // the heurisitic is the straight line distance from a position to the
+    // end, or the landmarks' bound on its route there when that's larger;
+    // the landmark bound is only admissible, not consistent, so a position
+    // may be settled again when a cheaper way to it turns up
+    const LandmarkTable* landmarks = (m_algorithm == ROUTE_LANDMARK_ASTAR) ? m_landmarks : nullptr;
+    auto heuristic = [&](NodeId node) {
+        double crow_flies = distanceEarthMiles(m_street_map_ptr->NodeFixedCoord(node), end_coord);
+        return landmarks == nullptr ? crow_flies : max(crow_flies, landmarks->LowerBound(node, end));
+    };
+
+    // set up the starting position
+    search_space.Update(start, 0, NO_NODE, NO_EDGE);
+    search_space.Push(start, heuristic(start));
+    
+    while(!search_space.QueueEmpty())
     {
-        // Utilization of the A* algorithm
-        bool route_found = false;
-        double next_move_cost, rank;
-        vector<StreetSegment> next_moves;
-        GeoCoord nextPos;
-        MinheapQueue search_space;
-        ExpandableHashMap<GeoCoord, StreetPair> prev_location;
-        ExpandableHashMap<GeoCoord, double> move_cost;
-
-        // set up the starting position
-        search_space.Insert(start, 0);
-        StreetPair start_pos_seg_pair(start);
-        prev_location.Associate(start, start_pos_seg_pair);
-        move_cost.Associate(start, 0);
+        NodeId currPos = search_space.PopMin();
+        // skip queue entries left behind by a later, cheaper update
+        if(search_space.Settled(currPos))
+            continue;
+        search_space.Settle(currPos);
+        num_settled++;
         
-        while(!search_space.IsEmpty())
+        if(currPos == end)
         {
-            GeoCoord currPos = search_space.GetTopPos();
-            
-            if(currPos == end)
-            {
-                route_found = true;
-                break;
-            }
-            
-            search_space.PopTop();
-            
-            m_street_map_ptr -> GetSegmentsThatStartWith(currPos, next_moves);
-            for(StreetSegment nextSeg: next_moves)
+            route_found = true;
+            break;
+        }
+        
+        for(StreetEdge next_edge: m_street_map_ptr->Neighbors(currPos))
+        {
+            NodeId nextPos = next_edge.target;
+            next_move_cost = search_space.Cost(currPos) + next_edge.length;
+            // add new position into search space
+            if(!search_space.Reached(nextPos) || next_move_cost < search_space.Cost(nextPos))
             {
-                nextPos = nextSeg.end;
-                next_move_cost = *move_cost.Find(currPos) + distanceEarthMiles(currPos, nextPos);
-                // add new position into search space
-                if(!move_cost.Find(nextPos) || next_move_cost < *move_cost.Find(nextPos))
-                {
-                    move_cost.Associate(nextPos, next_move_cost);
-                    // here, our heurisitic is just the distance to the end
-                    rank = next_move_cost + distanceEarthMiles(currPos, end);
-                    search_space.Insert(nextPos, rank);
-                    StreetPair pos_seg_pair(currPos, nextSeg.name);
-                    prev_location.Associate(nextPos, pos_seg_pair);
-                }
+                search_space.Update(nextPos, next_move_cost, currPos, next_edge.id);
+                search_space.Push(nextPos, next_move_cost + heuristic(nextPos));
             }
         }
+    }
+    
+    // save the edges followed into the route, walking back from the end
+    if(route_found)
+    {
+        for(NodeId node = end; node != start; node = search_space.Parent(node))
+            route.push_back(search_space.ParentEdge(node));
+        reverse(route.begin(), route.end());
+        total_dist_travelled = search_space.Cost(end);
+    }
+    return route_found;
+}
+
+bool PointToPointRouterImpl::SearchBidirectional(NodeId start, NodeId end, vector<EdgeId>& route,
+                                                 double& total_dist_travelled, unsigned long& num_settled) const
+{
+    // Both searches share one potential, half the straight line distance to
+    // the end less half the distance from the start, negated for the search
+    // from the end. Averaging keeps it consistent for both directions, so
+    // the two searches see the same non-negative reduced edge costs and the
+    // usual bidirectional Dijkstra stopping rule applies to their keys: once
+    // the smallest keys of the two queues add up to at least the shortest
+    // route seen where they meet, no shorter route remains.
+    const StreetMap& sm = *m_street_map_ptr;
+    const FixedCoord start_coord = sm.NodeFixedCoord(start), end_coord = sm.NodeFixedCoord(end);
+    auto potential = [&](NodeId node) {
+        FixedCoord coord = sm.NodeFixedCoord(node);
+        return (distanceEarthMiles(coord, end_coord) - distanceEarthMiles(start_coord, coord)) / 2;
+    };
+
+    SearchSpace* searches[2] = {&threadSearchSpace(0), &threadSearchSpace(1)};
+    NodeId roots[2] = {start, end};
+    for(int side = 0; side < 2; side++)
+    {
+        searches[side]->Reset(sm.NodeCount());
+        searches[side]->Update(roots[side], 0, NO_NODE, NO_EDGE);
+        searches[side]->Push(roots[side], side == 0 ? potential(roots[side]) : -potential(roots[side]));
+    }
+
+    double best_len = (start == end) ? 0.0 : -1.0;
+    NodeId meeting_node = (start == end) ? start : NO_NODE;
+    while(!searches[0]->QueueEmpty() && !searches[1]->QueueEmpty())
+    {
+        if(best_len >= 0 && searches[0]->TopRank() + searches[1]->TopRank() >= best_len)
+            break;
+        
+        // advance whichever side has the smaller key
+        int side = (searches[0]->TopRank() <= searches[1]->TopRank()) ? 0 : 1;
+        SearchSpace& search = *searches[side];
+        SearchSpace& other = *searches[1 - side];
+        NodeId currPos = search.PopMin();
+        if(search.Settled(currPos))
+            continue;
+        search.Settle(currPos);
+        num_settled++;
         
-        // save the instructions into the route list
-        if(route_found)
+        for(StreetEdge next_edge: sm.Neighbors(currPos))
         {
-            GeoCoord endCoord = end;
-            StreetPair start_pos_seg_pair = *prev_location.Find(end);
-            string streetName = start_pos_seg_pair.m_name;
-            // stop sequence indicated by "" as m_name
-            while(start_pos_seg_pair.m_name != "")
+            NodeId nextPos = next_edge.target;
+            double next_move_cost = search.Cost(currPos) + next_edge.length;
+            if(search.Reached(nextPos) && next_move_cost >= search.Cost(nextPos))
+                continue;
+            search.Update(nextPos, next_move_cost, currPos, next_edge.id);
+            search.Push(nextPos, next_move_cost + (side == 0 ? potential(nextPos) : -potential(nextPos)));
+            
+            // keep track of the shortest route through a node both sides reached
+            if(other.Reached(nextPos) && (best_len < 0 || next_move_cost + other.Cost(nextPos) < best_len))
             {
-                StreetSegment routeSeg(start_pos_seg_pair.m_coord, endCoord, streetName);
-                route.insert(route.begin(), routeSeg);
-                total_dist_travelled += distanceEarthMiles(routeSeg.start, routeSeg.end);
-                
-                endCoord = start_pos_seg_pair.m_coord;
-                start_pos_seg_pair = *prev_location.Find(endCoord);
-                streetName = start_pos_seg_pair.m_name;
+                best_len = next_move_cost + other.Cost(nextPos);
+                meeting_node = nextPos;
             }
         }
-        return route_found ? DELIVERY_SUCCESS : NO_ROUTE;
     }
+    
+    if(meeting_node != NO_NODE)
+    {
+        // the start's half of the route, then the end's half turned around
+        for(NodeId node = meeting_node; node != start; node = searches[0]->Parent(node))
+            route.push_back(searches[0]->ParentEdge(node));
+        reverse(route.begin(), route.end());
+        for(NodeId node = meeting_node; node != end; node = searches[1]->Parent(node))
+            route.push_back(reverseEdge(sm, searches[1]->Parent(node), searches[1]->ParentEdge(node)));
+        total_dist_travelled = best_len;
+    }
+    return meeting_node != NO_NODE;
 }
 
 // Functions added by Professors Nachenburg and Smallberg for grading purposes
 
-PointToPointRouter::PointToPointRouter(const StreetMap* sm)
+PointToPointRouter::PointToPointRouter(const StreetMap* sm, RouteAlgorithm algorithm)
 {
-    m_impl = new PointToPointRouterImpl(sm);
+    m_impl = new PointToPointRouterImpl(sm, algorithm, nullptr, nullptr);
+}
+
+PointToPointRouter::PointToPointRouter(const StreetMap* sm, const ContractionHierarchy* ch)
+{
+    m_impl = new PointToPointRouterImpl(sm, ROUTE_CONTRACTION_HIERARCHY, ch, nullptr);
+}
+
+PointToPointRouter::PointToPointRouter(const StreetMap* sm, const LandmarkTable* landmarks)
+{
+    m_impl = new PointToPointRouterImpl(sm, ROUTE_LANDMARK_ASTAR, nullptr, landmarks);
 }
 
 PointToPointRouter::~PointToPointRouter()
@@ -175,3 +334,27 @@ DeliveryResult PointToPointRouter::GeneratePointToPointRoute(
     return m_impl->GeneratePointToPointRoute(start, end, route, total_dist_travelled);
 }
 
+
+DeliveryResult PointToPointRouter::GenerateNodeRoute(
+        NodeId start,
+        NodeId end,
+        vector<EdgeId>& route,
+        double& total_dist_travelled) const
+{
+    return m_impl->GenerateNodeRoute(start, end, route, total_dist_travelled);
+}
+
+void PointToPointRouter::SetRouteCache(RouteCache* cache)
+{
+    m_impl->SetRouteCache(cache);
+}
+
+RouterStats PointToPointRouter::Stats() const
+{
+    return m_impl->Stats();
+}
+
+void PointToPointRouter::ResetStats()
+{
+    m_impl->ResetStats();
+}
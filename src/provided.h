@@ -11,6 +11,8 @@
 #include <string>
 #include <vector>
 #include <list>
+#include <cstdint>
+#include <cstddef>
 
 enum DeliveryResult
 {
@@ -74,15 +76,153 @@ bool operator==(const StreetSegment& lhs, const StreetSegment& rhs)
     return lhs.start == rhs.start  &&  lhs.end == rhs.end;
 }
 
+  // A coordinate held as whole multiples of 1e-7 degrees, the precision the
+  // map data is written with
+struct FixedCoord
+{
+    std::int32_t lat;
+    std::int32_t lon;
+};
+
+inline
+bool operator==(const FixedCoord& lhs, const FixedCoord& rhs)
+{
+    return lhs.lat == rhs.lat  &&  lhs.lon == rhs.lon;
+}
+
+inline
+bool operator<(const FixedCoord& lhs, const FixedCoord& rhs)
+{
+    return lhs.lat < rhs.lat  ||  (lhs.lat == rhs.lat  &&  lhs.lon < rhs.lon);
+}
+
+  // Ids of the nodes (distinct segment end points) and of the directed edges
+  // of a loaded StreetMap; both are dense, starting from 0
+typedef std::uint32_t NodeId;
+typedef std::uint32_t EdgeId;
+
+  // One edge of a StreetMap's graph, as handed out by an EdgeRange
+struct StreetEdge
+{
+    EdgeId        id;
+    NodeId        target;
+    double        length;   // in miles
+    std::uint32_t street;   // index of the street's name
+};
+
+  // A view of the edges leaving one node. It points straight into the
+  // StreetMap's adjacency arrays, so iterating it never allocates; it stays
+  // valid until the map is loaded again.
+class EdgeRange
+{
+public:
+    class iterator
+    {
+    public:
+        iterator(const EdgeRange& range, EdgeId edge)
+         : m_targets(range.m_targets), m_lengths(range.m_lengths), m_streets(range.m_streets), m_edge(edge)
+        {}
+
+        StreetEdge operator*() const
+        {
+            StreetEdge edge = { m_edge, m_targets[m_edge], m_lengths[m_edge], m_streets[m_edge] };
+            return edge;
+        }
+
+        iterator& operator++()
+        {
+            m_edge++;
+            return *this;
+        }
+
+        bool operator==(const iterator& other) const { return m_edge == other.m_edge; }
+        bool operator!=(const iterator& other) const { return m_edge != other.m_edge; }
+
+    private:
+        const NodeId*        m_targets;
+        const double*        m_lengths;
+        const std::uint32_t* m_streets;
+        EdgeId               m_edge;
+    };
+
+    EdgeRange(const NodeId* targets, const double* lengths, const std::uint32_t* streets,
+              EdgeId first, EdgeId end)
+     : m_targets(targets), m_lengths(lengths), m_streets(streets), m_first(first), m_end(end)
+    {}
+
+    iterator begin() const { return iterator(*this, m_first); }
+    iterator end() const { return iterator(*this, m_end); }
+    std::size_t size() const { return m_end - m_first; }
+    bool empty() const { return m_first == m_end; }
+
+private:
+    const NodeId*        m_targets;
+    const double*        m_lengths;
+    const std::uint32_t* m_streets;
+    EdgeId               m_first;
+    EdgeId               m_end;
+};
+
+  // Where a point falls on the streets of a StreetMap: the nearest point
+  // of the segment nearest it, the segment given as its edge leaving from
+  // for to
+struct StreetSnap
+{
+    EdgeId   edge;
+    NodeId   from;
+    NodeId   to;
+    double   fraction;     // how far along the segment the point is, 0 at from and 1 at to
+    GeoCoord point;        // the point itself, to the map's 7 decimal places
+    double   distance;     // from the point asked about to point, in miles
+};
+
+  // how far a depot or delivery may be from the nearest street and still
+  // be planned for
+const double MAX_SNAP_MILES = 0.25;
+
 class StreetMapImpl;
 
+  // A loaded StreetMap is never modified by its const member functions, so
+  // any number of threads may use a const StreetMap at once, and likewise
+  // the const members of the routers, hierarchies, landmark tables and
+  // distance matrices built over it. Only load() must not run while other
+  // threads use the map.
 class StreetMap
 {
 public:
     StreetMap();
     ~StreetMap();
+      // accepts either a text map data file or a file written by compile()
     bool load(std::string mapFile);
+      // writes the loaded map as a compiled binary map, which later loads
+      // are able to memory map instead of parsing
+    bool compile(std::string compiledMapFile) const;
     bool GetSegmentsThatStartWith(const GeoCoord& gc, std::vector<StreetSegment>& segs) const;
+
+      // The street graph by id. Ids are only meaningful for the map that
+      // handed them out and are invalidated by another load().
+    NodeId NodeCount() const;
+    bool FindNode(const GeoCoord& gc, NodeId& node) const;
+    GeoCoord NodeCoord(NodeId node) const;
+    FixedCoord NodeFixedCoord(NodeId node) const;
+    EdgeRange Neighbors(NodeId node) const;
+    NodeId EdgeTarget(EdgeId edge) const;
+    double EdgeLength(EdgeId edge) const;
+    std::uint32_t EdgeStreet(EdgeId edge) const;
+    std::string StreetName(std::uint32_t street) const;
+      // a checksum of the graph, used to tie files derived from a map to it
+    std::uint64_t Fingerprint() const;
+      // The nearest point on any street to gc. The map is bucketed into a
+      // grid when it's loaded, so this only looks at the segments in the
+      // cells around gc. False for an empty map or unreadable coordinates.
+    bool SnapToStreet(const GeoCoord& gc, StreetSnap& snap) const;
+      // the node nearest gc in a straight line, likewise from the grid
+    bool NearestNode(const GeoCoord& gc, NodeId& node) const;
+      // The node at gc, or else the nearer end of the segment nearest gc,
+      // so long as gc is within maxMiles of that segment. The planner routes
+      // a depot or delivery that isn't exactly on a node to and from this
+      // node, and drives the rest of the way along the segment from it.
+    bool SnapToNode(const GeoCoord& gc, NodeId& node, double maxMiles = MAX_SNAP_MILES) const;
       // We prevent a StreetMap object from being copied or assigned.
     StreetMap(const StreetMap&) = delete;
     StreetMap& operator=(const StreetMap&) = delete;
@@ -90,18 +230,191 @@ private:
     StreetMapImpl* m_impl;
 };
 
+  // how a PointToPointRouter searches for routes
+enum RouteAlgorithm
+{
+    ROUTE_ASTAR,                  // A* forward from the start
+    ROUTE_BIDIRECTIONAL_ASTAR,    // A* from both ends at once, meeting in the middle
+    ROUTE_CONTRACTION_HIERARCHY,  // upward searches over a ContractionHierarchy
+    ROUTE_LANDMARK_ASTAR          // A* guided by the bounds of a LandmarkTable
+};
+
+class ContractionHierarchyImpl;
+
+  // Shortcuts added over a StreetMap by contracting its nodes one at a time
+  // in order of importance. A query then only searches upward in that order
+  // from both ends, settling a few hundred nodes where A* settles thousands.
+class ContractionHierarchy
+{
+public:
+    ContractionHierarchy(const StreetMap* sm);
+    ~ContractionHierarchy();
+      // preprocesses the whole map; this takes a while, so a built hierarchy
+      // is usually saved and loaded again for later runs
+    void Build();
+    bool IsBuilt() const;
+    bool save(std::string hierarchyFile) const;
+      // fails if the file was built from a different map
+    bool load(std::string hierarchyFile);
+      // the shortest route between two nodes, with shortcuts unpacked back
+      // into the map's own edges
+    DeliveryResult GenerateNodeRoute(
+        NodeId start,
+        NodeId end,
+        std::vector<EdgeId>& route,
+        double& totalDistanceTravelled,
+        unsigned long* nodesSettled = nullptr) const;
+      // We prevent a ContractionHierarchy object from being copied or assigned.
+    ContractionHierarchy(const ContractionHierarchy&) = delete;
+    ContractionHierarchy& operator=(const ContractionHierarchy&) = delete;
+private:
+    ContractionHierarchyImpl* m_impl;
+};
+
+  // how a LandmarkTable places its landmarks
+enum LandmarkSelection
+{
+    LANDMARKS_FARTHEST,   // each one as far as possible from those before it
+    LANDMARKS_AVOID       // each one where the landmarks so far bound distances worst
+};
+
+class LandmarkTableImpl;
+
+  // Distances from a few landmark nodes to every node of a StreetMap. By the
+  // triangle inequality they bound the distance between any two nodes from
+  // below, much more tightly than a straight line where the streets wind.
+class LandmarkTable
+{
+public:
+    LandmarkTable(const StreetMap* sm);
+    ~LandmarkTable();
+      // runs one Dijkstra over the map per landmark; quantized tables store
+      // each distance in 16 bits rather than 32, at the cost of looser bounds
+    void Build(int numLandmarks, LandmarkSelection selection = LANDMARKS_AVOID, bool quantized = false);
+    bool IsBuilt() const;
+    int LandmarkCount() const;
+    NodeId Landmark(int index) const;
+      // a lower bound on the length of the shortest route between two nodes
+    double LowerBound(NodeId from, NodeId to) const;
+      // We prevent a LandmarkTable object from being copied or assigned.
+    LandmarkTable(const LandmarkTable&) = delete;
+    LandmarkTable& operator=(const LandmarkTable&) = delete;
+private:
+    LandmarkTableImpl* m_impl;
+};
+
+class DepotTreeImpl;
+
+  // The shortest routes from a depot to every node of a StreetMap, found
+  // with one Dijkstra over the whole map. Every street runs both ways, so
+  // they're the shortest routes back to the depot too: any leg to or from
+  // the depot is a walk up the tree, and its length a single lookup.
+class DepotTree
+{
+public:
+    DepotTree(const StreetMap* sm);
+    ~DepotTree();
+      // the depot is snapped to the map as StreetMap::SnapToNode does;
+      // BAD_COORD if it's too far from any street
+    DeliveryResult Build(const GeoCoord& depot);
+    bool IsBuilt() const;
+      // the depot's node
+    NodeId Root() const;
+      // the road distance between the depot and node, infinite if there's
+      // no route between them
+    double Distance(NodeId node) const;
+      // the route from the depot to node, as GenerateNodeRoute gives it
+    DeliveryResult RouteFromDepot(NodeId node, std::vector<EdgeId>& route, double& totalDistanceTravelled) const;
+      // the route from node back to the depot
+    DeliveryResult RouteToDepot(NodeId node, std::vector<EdgeId>& route, double& totalDistanceTravelled) const;
+      // We prevent a DepotTree object from being copied or assigned.
+    DepotTree(const DepotTree&) = delete;
+    DepotTree& operator=(const DepotTree&) = delete;
+private:
+    DepotTreeImpl* m_impl;
+};
+
+  // running totals over every query a PointToPointRouter has answered
+struct RouterStats
+{
+    unsigned long long queries;
+    unsigned long long nodesSettled;
+};
+
+  // running totals over every lookup a RouteCache has answered
+struct RouteCacheStats
+{
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long evictions;
+    std::size_t entries;             // routes held right now
+};
+
+class RouteCacheImpl;
+
+  // A bounded cache of the routes found between pairs of nodes, which any
+  // number of routers, on any number of threads, may share. Every street
+  // runs both ways, so a route is held once per pair of nodes and served
+  // in either direction. Once full, each new route evicts one that hasn't
+  // been looked up lately, chosen by the CLOCK algorithm.
+class RouteCache
+{
+public:
+    RouteCache(const StreetMap* sm, std::size_t capacity = 100000);
+    ~RouteCache();
+      // the route cached between two nodes, if there is one, as
+      // GenerateNodeRoute would give it; a pair found to have no route
+      // between them is cached as NO_ROUTE
+    bool Lookup(NodeId start, NodeId end, std::vector<EdgeId>& route,
+                double& totalDistanceTravelled, DeliveryResult& result);
+      // only DELIVERY_SUCCESS and NO_ROUTE results are cached
+    void Insert(NodeId start, NodeId end, const std::vector<EdgeId>& route,
+                double totalDistanceTravelled, DeliveryResult result);
+    void Clear();
+    RouteCacheStats Stats() const;
+    void ResetStats();
+      // Saves every route held, so another process can load them rather
+      // than start cold. The file is replaced whole, by way of snapshotFile
+      // plus ".tmp", so an interrupted save leaves the old one. Loading adds the saved routes to those held, up to
+      // the capacity, and fails if the file was saved over a different map.
+    bool save(std::string snapshotFile) const;
+    bool load(std::string snapshotFile);
+      // We prevent a RouteCache object from being copied or assigned.
+    RouteCache(const RouteCache&) = delete;
+    RouteCache& operator=(const RouteCache&) = delete;
+private:
+    RouteCacheImpl* m_impl;
+};
+
 class PointToPointRouterImpl;
 
 class PointToPointRouter
 {
 public:
-    PointToPointRouter(const StreetMap* sm);
+    PointToPointRouter(const StreetMap* sm, RouteAlgorithm algorithm = ROUTE_ASTAR);
+      // routes with ROUTE_CONTRACTION_HIERARCHY over a built hierarchy of sm
+    PointToPointRouter(const StreetMap* sm, const ContractionHierarchy* ch);
+      // routes with ROUTE_LANDMARK_ASTAR over a built landmark table of sm
+    PointToPointRouter(const StreetMap* sm, const LandmarkTable* landmarks);
     ~PointToPointRouter();
     DeliveryResult GeneratePointToPointRoute(
         const GeoCoord& start,
         const GeoCoord& end,
         std::list<StreetSegment>& route,
         double& totalDistanceTravelled) const;
+      // the same search between two nodes of the map; the route is given as
+      // the edges followed from start
+    DeliveryResult GenerateNodeRoute(
+        NodeId start,
+        NodeId end,
+        std::vector<EdgeId>& route,
+        double& totalDistanceTravelled) const;
+      // Looks routes up in cache before searching for them, and adds those
+      // found to it; nullptr, the default, for no cache. Not to be called
+      // while the router is answering queries.
+    void SetRouteCache(RouteCache* cache);
+    RouterStats Stats() const;
+    void ResetStats();
       // We prevent a PointToPointRouter object from being copied or assigned.
     PointToPointRouter(const PointToPointRouter&) = delete;
     PointToPointRouter& operator=(const PointToPointRouter&) = delete;
@@ -109,6 +422,30 @@ private:
     PointToPointRouterImpl* m_impl;
 };
 
+class DistanceMatrixImpl;
+
+  // Shortest road distances between every pair of a set of points, found
+  // with one Dijkstra sweep per point that stops once it has settled every
+  // point after it, rather than a separate route search per pair.
+class DistanceMatrix
+{
+public:
+    DistanceMatrix(const StreetMap* sm);
+    ~DistanceMatrix();
+      // BAD_COORD if a point isn't a node of the map; points that can't be
+      // reached from one another are an infinite distance apart
+    DeliveryResult Compute(const std::vector<GeoCoord>& points);
+    DeliveryResult Compute(const std::vector<NodeId>& nodes);
+    int Size() const;
+      // the distance from the point at index from to the one at index to
+    double Distance(int from, int to) const;
+      // We prevent a DistanceMatrix object from being copied or assigned.
+    DistanceMatrix(const DistanceMatrix&) = delete;
+    DistanceMatrix& operator=(const DistanceMatrix&) = delete;
+private:
+    DistanceMatrixImpl* m_impl;
+};
+
 struct DeliveryRequest
 {
     DeliveryRequest(std::string it, const GeoCoord& loc)
@@ -118,6 +455,87 @@ struct DeliveryRequest
     GeoCoord location;
 };
 
+  // what a DeliveryOptimizer minimizes the length of
+enum OptimizerCostModel
+{
+    COST_CROW_FLIES,     // straight lines between stops
+    COST_ROAD_DISTANCE   // shortest routes between stops, from a DistanceMatrix; only
+                         // up to 2,047 distinct stops, past which the matrix is too
+                         // big to keep and straight lines are used instead
+};
+
+  // how a DeliveryOptimizer searches for a shorter order
+enum OptimizerEngine
+{
+    ENGINE_ANNEALING,     // simulated annealing over random section flips and moves
+    ENGINE_LOCAL_SEARCH,  // 2-opt and Or-opt moves between each stop's nearest neighbors
+    ENGINE_LIN_KERNIGHAN, // annealing, then Lin-Kernighan style chains of moves; slowest, best
+    ENGINE_CLUSTERED      // stops split into clusters, each ordered on its own and then
+                          // joined; for manifests of tens of thousands of stops
+};
+
+struct OptimizerOptions
+{
+    OptimizerOptions()
+     : costModel(COST_CROW_FLIES), engine(ENGINE_ANNEALING), deterministic(false), seed(0),
+       numChains(1), timeBudgetMs(0), stallTemperatures(0), candidateCount(8), exactThreshold(12),
+       clusterSize(1000)
+    {}
+
+    OptimizerCostModel costModel;
+    OptimizerEngine engine;
+      // when set, the optimizer's random choices all follow from seed, so
+      // the same stops and options give the same tour every run; otherwise
+      // each run is seeded afresh
+    bool deterministic;
+    std::uint64_t seed;
+      // how many annealing chains to run side by side, each from its own
+      // seed, keeping the best tour any of them finds; 0 runs one per core
+    int numChains;
+      // Stop early, with the best tour found so far, once this much time
+      // has passed since the call began (0 for no limit) or once this many
+      // temperatures in a row have gone by without finding a shorter tour
+      // (0 to always cool fully). A time budget makes deterministic runs
+      // depend on how fast the machine is.
+    double timeBudgetMs;
+    int stallTemperatures;
+      // how many of each stop's nearest neighbors the local search tries
+      // joining it to
+    int candidateCount;
+      // Up to this many deliveries, whatever the engine, the order is found
+      // exactly by dynamic programming over subsets of the stops, in time
+      // and space doubling with each stop; at most 16, and 0 never.
+    int exactThreshold;
+      // about how many stops each cluster of ENGINE_CLUSTERED holds
+    int clusterSize;
+};
+
+  // what an optimization run did
+struct OptimizerReport
+{
+    OptimizerReport()
+     : elapsedMs(0), movesTried(0), temperatures(0), hitTimeBudget(false), stalled(false),
+       lowerBound(0), gap(0), optimal(false), numStops(0), usedRoadDistances(false)
+    {}
+
+    double elapsedMs;
+    unsigned long long movesTried;   // over every chain
+    int temperatures;                // the most any chain cooled through
+    bool hitTimeBudget;
+    bool stalled;
+      // For ENGINE_LIN_KERNIGHAN, a length no tour through the stops can
+      // beat (0 if there was no time to work it out), and how far over it
+      // the tour found is, as a fraction of it.
+    double lowerBound;
+    double gap;
+    bool optimal;                    // the order was found exactly
+    int numStops;                    // distinct places delivered to
+      // whether the tour was measured by road; false for COST_ROAD_DISTANCE
+      // means it fell back on straight lines, for too many stops or for one
+      // that's off the map or can't be reached
+    bool usedRoadDistances;
+};
+
 class DeliveryOptimizerImpl;
 
 class DeliveryOptimizer
@@ -130,6 +548,27 @@ public:
         std::vector<DeliveryRequest>& deliveries,
         double& oldCrowDistance,
         double& newCrowDistance) const;
+      // the same, measuring the old and new tours by options.costModel;
+      // road distances fall back on straight lines when a stop isn't on the
+      // map or can't be reached, or when there are over 2,047 distinct stops
+      // (see OptimizerReport::usedRoadDistances)
+    void OptimizeDeliveryOrder(
+        const GeoCoord& depot,
+        std::vector<DeliveryRequest>& deliveries,
+        double& oldDistance,
+        double& newDistance,
+        const OptimizerOptions& options) const;
+      // the same, also describing how the run went in report
+    void OptimizeDeliveryOrder(
+        const GeoCoord& depot,
+        std::vector<DeliveryRequest>& deliveries,
+        double& oldDistance,
+        double& newDistance,
+        const OptimizerOptions& options,
+        OptimizerReport& report) const;
+      // Road distances from the depot are read off tree, when the depot is
+      // its root, rather than searched for; nullptr, the default, for none.
+    void SetDepotTree(const DepotTree* tree);
       // We prevent a DeliveryOptimizer object from being copied or assigned.
     DeliveryOptimizer(const DeliveryOptimizer&) = delete;
     DeliveryOptimizer& operator=(const DeliveryOptimizer&) = delete;
@@ -211,6 +650,64 @@ private:
     double       m_distance;    // 1.92 (in miles)
 };
 
+class DeliveryPlanImpl;
+
+  // A plan for driving from a depot to deliveries in order and back, which
+  // keeps the route of every leg, so deliveries can be added and removed
+  // mid-shift at the cost of a couple of route searches.
+class DeliveryPlan
+{
+public:
+      // legs are looked up in routeCache, if given, before being routed,
+      // and legs to and from the root of depotTree read off it
+    DeliveryPlan(const StreetMap* sm, RouteCache* routeCache = nullptr, const DepotTree* depotTree = nullptr);
+    ~DeliveryPlan();
+      // routes every leg of making the deliveries in the order given;
+      // deliveries next to each other at one place are one stop, with
+      // every item delivered there. On failure the plan is left as it was.
+    DeliveryResult Route(const GeoCoord& depot, const std::vector<DeliveryRequest>& deliveries);
+      // Adds a delivery to the stop at its place, if there is one, or as a
+      // new stop between the two consecutive stops it adds least straight
+      // line distance between, routing just the two legs to and from it.
+      // BAD_COORD if the plan hasn't been routed; on failure the plan is
+      // left as it was.
+    DeliveryResult InsertDelivery(const DeliveryRequest& delivery);
+      // Removes a delivery of the same item to the same place. A stop left
+      // with nothing to deliver is dropped, and the stops either side joined
+      // by one new leg. BAD_COORD if the plan has no such delivery.
+    DeliveryResult RemoveDelivery(const DeliveryRequest& delivery);
+      // the deliveries in the order they'll be made
+    std::vector<DeliveryRequest> Deliveries() const;
+      // the turn-by-turn commands for the whole plan, as GenerateDeliveryPlan gives them
+    void GetCommands(std::vector<DeliveryCommand>& commands) const;
+    double TotalDistance() const;
+      // We prevent a DeliveryPlan object from being copied or assigned.
+    DeliveryPlan(const DeliveryPlan&) = delete;
+    DeliveryPlan& operator=(const DeliveryPlan&) = delete;
+private:
+    DeliveryPlanImpl* m_impl;
+};
+
+  // one driver's deliveries, planned as part of a batch
+struct DeliveryManifest
+{
+    GeoCoord depot;
+    std::vector<DeliveryRequest> deliveries;
+};
+
+  // what planning one manifest of a batch gave
+struct ManifestPlan
+{
+    ManifestPlan()
+     : result(NO_ROUTE), totalDistance(0), elapsedMs(0)
+    {}
+
+    DeliveryResult result;
+    std::vector<DeliveryCommand> commands;
+    double totalDistance;
+    double elapsedMs;                // spent planning this manifest
+};
+
 class DeliveryPlannerImpl;
 
 class DeliveryPlanner
@@ -218,11 +715,39 @@ class DeliveryPlanner
 public:
     DeliveryPlanner(const StreetMap* sm);
     ~DeliveryPlanner();
+      // A depot or delivery that isn't at a node is snapped to the nearest
+      // point on a street, as StreetMap::SnapToStreet finds it. Legs are
+      // routed to the nearer end of that segment, as StreetMap::SnapToNode
+      // places it, and the plan proceeds along the segment to the point,
+      // delivers there and proceeds back, so the tour is that much longer.
+      // BAD_COORD if a place is more than MAX_SNAP_MILES from any street.
     DeliveryResult GenerateDeliveryPlan(
         const GeoCoord& depot,
         const std::vector<DeliveryRequest>& deliveries,
         std::vector<DeliveryCommand>& commands,
         double& totalDistanceTravelled) const;
+      // the same, kept as a plan that can be changed later
+    DeliveryResult GenerateDeliveryPlan(
+        const GeoCoord& depot,
+        const std::vector<DeliveryRequest>& deliveries,
+        DeliveryPlan& plan) const;
+      // Plans every manifest, several at a time, filling in one plan per
+      // manifest in the same order. All of them share this planner's map
+      // and options.
+    void GenerateDeliveryPlans(
+        const std::vector<DeliveryManifest>& manifests,
+        std::vector<ManifestPlan>& plans) const;
+      // how later plans order their stops; by default by road distance,
+      // with no time budget
+    void SetOptimizerOptions(const OptimizerOptions& options);
+      // Later plans look their legs up in cache before routing them, and
+      // add those they route; nullptr, the default, for no cache.
+    void SetRouteCache(RouteCache* cache);
+      // Builds the shortest path tree from a depot, which later plans from
+      // that depot route their legs to and from it with, and measure its
+      // distance to each stop by; worth it for a depot many plans share.
+      // BAD_COORD if the depot isn't near a street.
+    DeliveryResult AddDepot(const GeoCoord& depot);
       // We prevent a DeliveryPlanner object from being copied or assigned.
     DeliveryPlanner(const DeliveryPlanner&) = delete;
     DeliveryPlanner& operator=(const DeliveryPlanner&) = delete;
@@ -247,22 +772,33 @@ inline double rad2deg(double rad) {
     return rad * 180 / PI;
 }
 
-inline double distanceEarthKM(const GeoCoord& g1, const GeoCoord& g2) {
+inline double distanceEarthKM(double lat1, double lon1, double lat2, double lon2) {
     static const double earthRadiusKm = 6371.0;
-    double lat1r = deg2rad(g1.latitude);
-    double lon1r = deg2rad(g1.longitude);
-    double lat2r = deg2rad(g2.latitude);
-    double lon2r = deg2rad(g2.longitude);
+    double lat1r = deg2rad(lat1);
+    double lon1r = deg2rad(lon1);
+    double lat2r = deg2rad(lat2);
+    double lon2r = deg2rad(lon2);
     double u = std::sin((lat2r - lat1r) / 2);
     double v = std::sin((lon2r - lon1r) / 2);
     return 2.0 * earthRadiusKm * std::asin(std::sqrt(u * u + std::cos(lat1r) * std::cos(lat2r) * v * v));
 }
 
+inline double distanceEarthKM(const GeoCoord& g1, const GeoCoord& g2) {
+    return distanceEarthKM(g1.latitude, g1.longitude, g2.latitude, g2.longitude);
+}
+
 inline double distanceEarthMiles(const GeoCoord& g1, const GeoCoord& g2) {
     const double milesPerKm = 1 / 1.609344;
     return distanceEarthKM(g1, g2) * milesPerKm;
 }
 
+inline double distanceEarthMiles(const FixedCoord& f1, const FixedCoord& f2) {
+    const double milesPerKm = 1 / 1.609344;
+    const double unitsPerDegree = 1e7;
+    return distanceEarthKM(f1.lat / unitsPerDegree, f1.lon / unitsPerDegree,
+                           f2.lat / unitsPerDegree, f2.lon / unitsPerDegree) * milesPerKm;
+}
+
 inline double angleBetween2Lines(const StreetSegment& line1, const StreetSegment& line2)
 {
     double angle1 = atan2(line1.end.latitude - line1.start.latitude, line1.end.longitude - line1.start.longitude);
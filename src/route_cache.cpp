@@ -0,0 +1,419 @@
+//  Author:  Noah Himed
+//  Date:    16 October 2026
+//  Summary: Caches the routes found between pairs of nodes, evicting with
+//           the CLOCK algorithm, and saves them to snapshot files.
+
+#include "provided.h"
+#include "graph_search.h"
+#include "map_format.h"
+
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+// Lookups on different pairs rarely wait on one another, as the cache is
+// split into this many shards, each with its own lock.
+const size_t MAX_CACHE_SHARDS = 16;
+
+// Layout of a snapshot: the header, then for each route its two nodes,
+// its number of edges, whether there is a route, its length and its
+// edges, written in the host's byte order like a compiled map.
+const char SNAPSHOT_MAGIC[8] = {'D', 'N', 'R', 'C', 'B', 'I', 'N', '\0'};
+const uint32_t SNAPSHOT_VERSION = 1;
+
+struct SnapshotHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t endian_tag;
+    uint64_t num_routes;
+    uint64_t map_fingerprint;   // StreetMap::Fingerprint of the map routed over
+    uint64_t checksum;          // mapChecksum of every byte after the header
+};
+
+struct SnapshotRoute
+{
+    uint32_t from;
+    uint32_t to;
+    uint32_t num_edges;
+    uint32_t has_route;
+    double   distance;
+};
+
+class RouteCacheImpl
+{
+public:
+    RouteCacheImpl(const StreetMap* sm, size_t capacity);
+    ~RouteCacheImpl();
+    bool Lookup(NodeId start, NodeId end, vector<EdgeId>& route,
+                double& total_dist_travelled, DeliveryResult& result);
+    void Insert(NodeId start, NodeId end, const vector<EdgeId>& route,
+                double total_dist_travelled, DeliveryResult result);
+    void Clear();
+    RouteCacheStats Stats() const;
+    void ResetStats();
+    bool Save(string snapshot_path) const;
+    bool Load(string snapshot_path);
+private:
+    // A route from the lower numbered node of a pair to the higher, which
+    // is turned around when asked for the other way.
+    struct Entry
+    {
+        uint64_t key;
+        vector<EdgeId> edges;
+        double distance;
+        bool has_route;
+        // set by every lookup, and cleared as the clock hand passes
+        bool referenced;
+    };
+    struct Shard
+    {
+        mutex lock;
+        unordered_map<uint64_t, size_t> slot_of;
+        vector<Entry> slots;
+        size_t capacity;
+        size_t hand;
+    };
+    static uint64_t PairKey(NodeId from, NodeId to) { return (uint64_t(from) << 32) | to; }
+    Shard& ShardOf(uint64_t key) const
+    {
+        return *m_shards[(key * 0x9E3779B97F4A7C15ULL >> 32) % m_shards.size()];
+    }
+    // adds a route from the lower node to the higher, holding the shard's lock
+    void Store(Shard& shard, uint64_t key, const vector<EdgeId>& edges, double distance, bool has_route);
+
+    const StreetMap *m_sm_ptr;
+    vector<unique_ptr<Shard>> m_shards;
+    atomic<unsigned long long> m_hits;
+    atomic<unsigned long long> m_misses;
+    atomic<unsigned long long> m_evictions;
+};
+
+RouteCacheImpl::RouteCacheImpl(const StreetMap* sm, size_t capacity)
+: m_sm_ptr(sm), m_hits(0), m_misses(0), m_evictions(0)
+{
+    // share the capacity out between the shards as evenly as it goes
+    size_t num_shards = max(size_t(1), min(MAX_CACHE_SHARDS, capacity));
+    for(size_t i = 0; i < num_shards; i++)
+    {
+        m_shards.emplace_back(new Shard);
+        m_shards.back()->capacity = capacity / num_shards + (i < capacity % num_shards ? 1 : 0);
+        m_shards.back()->hand = 0;
+    }
+}
+
+RouteCacheImpl::~RouteCacheImpl()
+{}
+
+bool RouteCacheImpl::Lookup(NodeId start, NodeId end, vector<EdgeId>& route,
+                            double& total_dist_travelled, DeliveryResult& result)
+{
+    const bool reversed = end < start;
+    const uint64_t key = reversed ? PairKey(end, start) : PairKey(start, end);
+    Shard& shard = ShardOf(key);
+    {
+        lock_guard<mutex> shard_guard(shard.lock);
+        auto found = shard.slot_of.find(key);
+        if(found == shard.slot_of.end())
+        {
+            m_misses++;
+            return false;
+        }
+        Entry& entry = shard.slots[found->second];
+        entry.referenced = true;
+        route = entry.edges;
+        total_dist_travelled = entry.distance;
+        result = entry.has_route ? DELIVERY_SUCCESS : NO_ROUTE;
+    }
+    m_hits++;
+
+    // follow the edges back the other way, last first
+    if(reversed && !route.empty())
+    {
+        vector<NodeId> from(route.size());
+        NodeId node = end;
+        for(size_t i = 0; i < route.size(); i++)
+        {
+            from[i] = node;
+            node = m_sm_ptr->EdgeTarget(route[i]);
+        }
+        reverse(route.begin(), route.end());
+        reverse(from.begin(), from.end());
+        for(size_t i = 0; i < route.size(); i++)
+            route[i] = reverseEdge(*m_sm_ptr, from[i], route[i]);
+    }
+    return true;
+}
+
+void RouteCacheImpl::Insert(NodeId start, NodeId end, const vector<EdgeId>& route,
+                            double total_dist_travelled, DeliveryResult result)
+{
+    if(result == BAD_COORD)
+        return;
+    if(end < start)
+    {
+        // store it the other way round, found as in Lookup
+        vector<EdgeId> edges(route.size());
+        NodeId node = start;
+        for(size_t i = 0; i < route.size(); i++)
+        {
+            edges[route.size() - 1 - i] = reverseEdge(*m_sm_ptr, node, route[i]);
+            node = m_sm_ptr->EdgeTarget(route[i]);
+        }
+        const uint64_t key = PairKey(end, start);
+        Shard& shard = ShardOf(key);
+        lock_guard<mutex> shard_guard(shard.lock);
+        Store(shard, key, edges, total_dist_travelled, result == DELIVERY_SUCCESS);
+        return;
+    }
+    const uint64_t key = PairKey(start, end);
+    Shard& shard = ShardOf(key);
+    lock_guard<mutex> shard_guard(shard.lock);
+    Store(shard, key, route, total_dist_travelled, result == DELIVERY_SUCCESS);
+}
+
+void RouteCacheImpl::Store(Shard& shard, uint64_t key, const vector<EdgeId>& edges, double distance, bool has_route)
+{
+    if(shard.capacity == 0)
+        return;
+    auto found = shard.slot_of.find(key);
+    if(found != shard.slot_of.end())
+    {
+        Entry& entry = shard.slots[found->second];
+        entry.edges = edges;
+        entry.distance = distance;
+        entry.has_route = has_route;
+        return;
+    }
+    if(shard.slots.size() < shard.capacity)
+    {
+        shard.slot_of[key] = shard.slots.size();
+        shard.slots.push_back(Entry{key, edges, distance, has_route, false});
+        return;
+    }
+
+    // sweep the hand round, giving each route looked up since it last
+    // passed a second chance, and replace the first route that has none
+    while(shard.slots[shard.hand].referenced)
+    {
+        shard.slots[shard.hand].referenced = false;
+        shard.hand = (shard.hand + 1) % shard.slots.size();
+    }
+    Entry& victim = shard.slots[shard.hand];
+    shard.slot_of.erase(victim.key);
+    shard.slot_of[key] = shard.hand;
+    victim = Entry{key, edges, distance, has_route, false};
+    shard.hand = (shard.hand + 1) % shard.slots.size();
+    m_evictions++;
+}
+
+void RouteCacheImpl::Clear()
+{
+    for(auto& shard : m_shards)
+    {
+        lock_guard<mutex> shard_guard(shard->lock);
+        shard->slot_of.clear();
+        shard->slots.clear();
+        shard->hand = 0;
+    }
+}
+
+RouteCacheStats RouteCacheImpl::Stats() const
+{
+    RouteCacheStats stats;
+    stats.hits = m_hits;
+    stats.misses = m_misses;
+    stats.evictions = m_evictions;
+    stats.entries = 0;
+    for(auto& shard : m_shards)
+    {
+        lock_guard<mutex> shard_guard(shard->lock);
+        stats.entries += shard->slots.size();
+    }
+    return stats;
+}
+
+void RouteCacheImpl::ResetStats()
+{
+    m_hits = 0;
+    m_misses = 0;
+    m_evictions = 0;
+}
+
+bool RouteCacheImpl::Save(string snapshot_path) const
+{
+    string payload;
+    auto append = [&payload](const void* data, size_t num_bytes) {
+        payload.append(static_cast<const char*>(data), num_bytes);
+    };
+    uint64_t num_routes = 0;
+    for(auto& shard : m_shards)
+    {
+        lock_guard<mutex> shard_guard(shard->lock);
+        for(const Entry& entry : shard->slots)
+        {
+            SnapshotRoute route;
+            memset(&route, 0, sizeof(route));
+            route.from = uint32_t(entry.key >> 32);
+            route.to = uint32_t(entry.key);
+            route.num_edges = uint32_t(entry.edges.size());
+            route.has_route = entry.has_route ? 1 : 0;
+            route.distance = entry.distance;
+            append(&route, sizeof(route));
+            append(entry.edges.data(), entry.edges.size()*sizeof(EdgeId));
+            num_routes++;
+        }
+    }
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.endian_tag = COMPILED_MAP_ENDIAN_TAG;
+    header.num_routes = num_routes;
+    header.map_fingerprint = m_sm_ptr->Fingerprint();
+    header.checksum = mapChecksum(payload.data(), payload.size());
+
+    // Written beside the snapshot and renamed over it, so a process killed
+    // mid-save, as a server usually is, still leaves the last whole one.
+    const string temp_path = snapshot_path + ".tmp";
+    ofstream snapshot_file(temp_path, ios::binary | ios::trunc);
+    if(!snapshot_file)
+        return false;
+    snapshot_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    snapshot_file.write(payload.data(), payload.size());
+    snapshot_file.close();
+    if(!snapshot_file || rename(temp_path.c_str(), snapshot_path.c_str()) != 0)
+    {
+        remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool RouteCacheImpl::Load(string snapshot_path)
+{
+    ifstream snapshot_file(snapshot_path, ios::binary);
+    if(!snapshot_file)
+        return false;
+    string contents((istreambuf_iterator<char>(snapshot_file)), istreambuf_iterator<char>());
+
+    SnapshotHeader header;
+    if(contents.size() < sizeof(header))
+        return false;
+    memcpy(&header, contents.data(), sizeof(header));
+    if(memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0
+       || header.version != SNAPSHOT_VERSION
+       || header.endian_tag != COMPILED_MAP_ENDIAN_TAG
+       || header.map_fingerprint != m_sm_ptr->Fingerprint()
+       || mapChecksum(contents.data() + sizeof(header), contents.size() - sizeof(header)) != header.checksum)
+        return false;
+
+    // check every route fits in the file and names the map's own nodes and
+    // edges before taking any of them
+    const NodeId num_nodes = m_sm_ptr->NodeCount();
+    const char* end = contents.data() + contents.size();
+    const char* pos = contents.data() + sizeof(header);
+    for(uint64_t i = 0; i < header.num_routes; i++)
+    {
+        SnapshotRoute route;
+        if(size_t(end - pos) < sizeof(route))
+            return false;
+        memcpy(&route, pos, sizeof(route));
+        pos += sizeof(route);
+        if(route.from >= num_nodes || route.to >= num_nodes || route.from > route.to
+           || size_t(end - pos) / sizeof(EdgeId) < route.num_edges)
+            return false;
+        NodeId node = route.from;
+        for(uint32_t j = 0; j < route.num_edges; j++)
+        {
+            EdgeId edge;
+            memcpy(&edge, pos + j*sizeof(EdgeId), sizeof(edge));
+            bool leaves_node = false;
+            for(StreetEdge next_edge : m_sm_ptr->Neighbors(node))
+                leaves_node = leaves_node || next_edge.id == edge;
+            if(!leaves_node)
+                return false;
+            node = m_sm_ptr->EdgeTarget(edge);
+        }
+        if(route.has_route && node != route.to)
+            return false;
+        pos += route.num_edges*sizeof(EdgeId);
+    }
+    if(pos != end)
+        return false;
+
+    pos = contents.data() + sizeof(header);
+    for(uint64_t i = 0; i < header.num_routes; i++)
+    {
+        SnapshotRoute route;
+        memcpy(&route, pos, sizeof(route));
+        pos += sizeof(route);
+        vector<EdgeId> edges(route.num_edges);
+        memcpy(edges.data(), pos, edges.size()*sizeof(EdgeId));
+        pos += edges.size()*sizeof(EdgeId);
+        const uint64_t key = PairKey(route.from, route.to);
+        Shard& shard = ShardOf(key);
+        lock_guard<mutex> shard_guard(shard.lock);
+        // a full cache keeps what it holds rather than cycle through the file
+        if(shard.slots.size() < shard.capacity || shard.slot_of.count(key) != 0)
+            Store(shard, key, edges, route.distance, route.has_route != 0);
+    }
+    return true;
+}
+
+RouteCache::RouteCache(const StreetMap* sm, size_t capacity)
+{
+    m_impl = new RouteCacheImpl(sm, capacity);
+}
+
+RouteCache::~RouteCache()
+{
+    delete m_impl;
+}
+
+bool RouteCache::Lookup(NodeId start, NodeId end, vector<EdgeId>& route,
+                        double& total_dist_travelled, DeliveryResult& result)
+{
+    return m_impl->Lookup(start, end, route, total_dist_travelled, result);
+}
+
+void RouteCache::Insert(NodeId start, NodeId end, const vector<EdgeId>& route,
+                        double total_dist_travelled, DeliveryResult result)
+{
+    m_impl->Insert(start, end, route, total_dist_travelled, result);
+}
+
+void RouteCache::Clear()
+{
+    m_impl->Clear();
+}
+
+RouteCacheStats RouteCache::Stats() const
+{
+    return m_impl->Stats();
+}
+
+void RouteCache::ResetStats()
+{
+    m_impl->ResetStats();
+}
+
+bool RouteCache::save(string snapshot_path) const
+{
+    return m_impl->Save(snapshot_path);
+}
+
+bool RouteCache::load(string snapshot_path)
+{
+    return m_impl->Load(snapshot_path);
+}
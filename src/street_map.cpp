@@ -5,20 +5,48 @@
 
 #include "provided.h"
 #include "expandable_hash_map.h"
+#include "map_format.h"
 
 #include <fstream>
 #include <string>
 #include <vector>
+#include <algorithm>
 #include <functional>
-#include <cctype>
+#include <cstdint>
 #include <cstring>
 #include <cstdlib>
+#include <cmath>
+#include <limits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace std;
 
-unsigned int hasher(const GeoCoord& g)
+// a street name still sitting in the map data buffer, used to look names up
+// without copying each one into a string first
+struct NameView
+{
+    const char* data;
+    size_t size;
+};
+
+inline bool operator==(const NameView& view, const string& s)
+{
+    return view.size == s.size() && memcmp(view.data, s.data(), view.size) == 0;
+}
+
+unsigned int hasher(const NameView& view)
 {
-    return static_cast<unsigned int>(std::hash<string>()(g.latitudeText + g.longitudeText));
+    return static_cast<unsigned int>(mapChecksum(view.data, view.size));
+}
+
+unsigned int hasher(const string& s)
+{
+    NameView view = {s.data(), s.size()};
+    return hasher(view);
 }
 
 class StreetMapImpl
@@ -26,104 +54,673 @@ class StreetMapImpl
 public:
     StreetMapImpl();
     ~StreetMapImpl();
+    // loads either a text map data file or a compiled map file, which is
+    // detected by its leading magic bytes
     bool Load(string map_data_path);
+    // writes the loaded map out in the compiled binary format
+    bool Compile(string compiled_map_path) const;
     // given a GeoCoord object which defines a point on a street, supply a vector of connecting
     // street segments
     bool GetSegmentsThatStartWith(const GeoCoord& gc, vector<StreetSegment>& segs) const;
+
+    NodeId NodeCount() const { return m_num_nodes; }
+    // coordinates are matched by value once parsed, not by their text
+    bool FindNode(const GeoCoord& gc, NodeId& node) const;
+    GeoCoord NodeCoord(NodeId node) const;
+    FixedCoord NodeFixedCoord(NodeId node) const { return m_nodes[node]; }
+    EdgeRange Neighbors(NodeId node) const
+    {
+        return EdgeRange(m_edge_targets, m_edge_lengths, m_edge_names, m_edge_offsets[node], m_edge_offsets[node + 1]);
+    }
+    NodeId EdgeTarget(EdgeId edge) const { return m_edge_targets[edge]; }
+    double EdgeLength(EdgeId edge) const { return m_edge_lengths[edge]; }
+    uint32_t EdgeStreet(EdgeId edge) const { return m_edge_names[edge]; }
+    string StreetName(uint32_t name) const;
+    uint64_t Fingerprint() const;
+    bool SnapToStreet(const GeoCoord& gc, StreetSnap& snap) const;
+    bool NearestNode(const GeoCoord& gc, NodeId& node) const;
+    bool SnapToNode(const GeoCoord& gc, NodeId& node, double max_miles) const;
 private:
-    // private auxillary function, adds segment to map
-    void AppendSegToMap(GeoCoord coord, StreetSegment seg);
-    ExpandableHashMap<GeoCoord, vector<StreetSegment>> m_coord_seg_map;
+    // one segment bucketed into the grid, by the edge leaving from
+    struct GridSegment
+    {
+        NodeId from;
+        EdgeId edge;
+    };
+
+    bool LoadText(const string& map_data_path);
+    bool LoadCompiled(const string& compiled_map_path);
+    void Unload();
+    // points the graph views at the owned vectors
+    void UseOwnedArrays();
+    // buckets the loaded map's nodes and segments into the grid
+    void BuildGrid();
+    // a coordinate's position on the grid's flat projection, in 1e-7 degrees
+    // of latitude north and east of the grid's corner
+    void GridPosition(const FixedCoord& coord, double& x, double& y) const;
+    uint32_t GridCell(double x, double y) const;
+    // visits the grid's cells a ring at a time outward from (x, y), until
+    // none left can hold anything nearer than best, which visit_cell lowers
+    // as it finds nearer things
+    template<typename Visit>
+    void SearchGrid(double x, double y, const double& best, Visit visit_cell) const;
+
+    // Read-only views of the graph. The node table is sorted by coordinate
+    // so a node's id is its index in it, and each node's edges are stored
+    // in compressed sparse row form. For a text map these point into the
+    // m_owned_* vectors below, for a compiled map straight into the mapping.
+    const FixedCoord* m_nodes;
+    const uint32_t* m_edge_offsets;
+    const uint32_t* m_edge_targets;
+    const double* m_edge_lengths;
+    const uint32_t* m_edge_names;
+    const uint32_t* m_name_offsets;
+    const char* m_names;
+    uint32_t m_num_nodes;
+    uint32_t m_num_edges;
+    uint32_t m_num_names;
+    uint64_t m_name_bytes;
+
+    vector<FixedCoord> m_owned_nodes;
+    vector<uint32_t> m_owned_edge_offsets;
+    vector<uint32_t> m_owned_edge_targets;
+    vector<double> m_owned_edge_lengths;
+    vector<uint32_t> m_owned_edge_names;
+    vector<uint32_t> m_owned_name_offsets;
+    string m_owned_names;
+
+    void* m_mapping;
+    size_t m_mapping_size;
+
+    // A uniform grid of square cells over the map's bounding box, about one
+    // for every two segments, on a flat projection of the map that shrinks
+    // longitude by the cosine of its middle latitude. Each cell lists the
+    // nodes in it and the segments whose bounding boxes overlap it, both in
+    // compressed sparse row form like the graph's edges. The grid is always
+    // built in memory, for text and compiled maps alike.
+    FixedCoord m_grid_corner;
+    double m_grid_cos_lat;
+    double m_cell_size;
+    uint32_t m_grid_rows;
+    uint32_t m_grid_cols;
+    vector<uint32_t> m_cell_node_offsets;
+    vector<NodeId> m_cell_nodes;
+    vector<uint32_t> m_cell_segment_offsets;
+    vector<GridSegment> m_cell_segments;
 };
 
 StreetMapImpl::StreetMapImpl()
-{}
+: m_mapping(nullptr), m_mapping_size(0), m_grid_cos_lat(1), m_cell_size(1), m_grid_rows(0), m_grid_cols(0)
+{
+    UseOwnedArrays();
+}
 
 StreetMapImpl::~StreetMapImpl()
-{}
+{
+    Unload();
+}
 
 bool StreetMapImpl::Load(string map_data_path)
 {
-    ifstream map_data_file(map_data_path);
+    Unload();
+
+    char magic[sizeof(COMPILED_MAP_MAGIC)] = {};
+    ifstream map_data_file(map_data_path, ios::binary);
+    if(!map_data_file)
+        return false;
+    map_data_file.read(magic, sizeof(magic));
+    map_data_file.close();
+
+    bool loaded = (memcmp(magic, COMPILED_MAP_MAGIC, sizeof(magic)) == 0)
+        ? LoadCompiled(map_data_path) : LoadText(map_data_path);
+    if(loaded)
+        BuildGrid();
+    return loaded;
+}
+
+bool StreetMapImpl::LoadText(const string& map_data_path)
+{
+    ifstream map_data_file(map_data_path, ios::binary);
     if(!map_data_file)
         return false;
-    
-    int line_num = 1, num_sig_figs = 7, num_segs = 0;
-    StreetSegment forward_seg, backward_seg;
-    string input_ln, start_lattitude, start_longitude, end_lattitude, end_longitude;
-    string* seg_end_points[4] = {&start_lattitude, &start_longitude, &end_lattitude, &end_longitude};
-    char next_char;
-    
-    // iterate through supplied map data file line by line,
-    // loading in information for line segments defining streets
-    while(getline(map_data_file, input_ln))
+    string map_data((istreambuf_iterator<char>(map_data_file)), istreambuf_iterator<char>());
+    map_data_file.close();
+
+    struct RawSegment
+    {
+        FixedCoord start;
+        FixedCoord end;
+        uint32_t name;
+    };
+    vector<RawSegment> raw_segs;
+    ExpandableHashMap<string, uint32_t> name_ids;
+    vector<uint32_t> name_offsets(1, 0);
+    string names;
+
+    int line_num = 1, num_segs = 0;
+    uint32_t street_name = 0;
+    const char* pos = map_data.data();
+    const char* data_end = pos + map_data.size();
+
+    // walk through the map data a line at a time: a street name, the number
+    // of segments making up that street, then one line per segment
+    while(pos != data_end)
     {
-        istringstream map_data(input_ln);
-        map_data.setf(ios::fixed);
-        map_data.precision(num_sig_figs);
+        const char* line_end = static_cast<const char*>(memchr(pos, '\n', data_end - pos));
+        if(line_end == nullptr)
+            line_end = data_end;
+        const char* next_line = (line_end == data_end) ? data_end : line_end + 1;
+        if(line_end != pos && *(line_end - 1) == '\r')
+            line_end--;
+
         switch (line_num)
         {
             case 1:
-                forward_seg.name = input_ln;
-                backward_seg.name = input_ln;
+            {
+                NameView name = {pos, size_t(line_end - pos)};
+                const uint32_t* existing = name_ids.Find(name);
+                if(existing != nullptr)
+                    street_name = *existing;
+                else
+                {
+                    street_name = uint32_t(name_offsets.size() - 1);
+                    names.append(name.data, name.size);
+                    name_offsets.push_back(uint32_t(names.size()));
+                    name_ids.Associate(string(name.data, name.size), street_name);
+                }
                 break;
-                
+            }
             case 2:
-                map_data >> num_segs;
+                num_segs = atoi(string(pos, line_end).c_str());
                 break;
             default:
             {
-                // modify start_lattitude, start_longitude, end_lattitude, end_longitude
-                // strings for each defined street segment
-                for (auto& seg_point_str : seg_end_points)
+                // read start lattitude, start longitude, end lattitude, end longitude
+                RawSegment seg;
+                int32_t* seg_end_points[4] = {&seg.start.lat, &seg.start.lon, &seg.end.lat, &seg.end.lon};
+                for(auto seg_point : seg_end_points)
                 {
-                    *seg_point_str = "";
-                    while(map_data.get(next_char) &&
-                      (isdigit(next_char) || next_char == '.' || next_char == '-'))
-                    *seg_point_str += next_char;
+                    while(pos != line_end && (*pos == ' ' || *pos == '\t' || *pos == ','))
+                        pos++;
+                    if(!parseFixedCoord(pos, line_end, *seg_point))
+                        return false;
                 }
-                
-                GeoCoord start_coord(start_lattitude, start_longitude), end_coord(end_lattitude, end_longitude);
-                
-                forward_seg.start = backward_seg.end = start_coord;
-                forward_seg.end = backward_seg.start = end_coord;
-                
-                // appends same line segment associated with both end points
-                // in street map
-                AppendSegToMap(start_coord, forward_seg);
-                AppendSegToMap(end_coord, backward_seg);
+                seg.name = street_name;
+                raw_segs.push_back(seg);
             }
         }
-        
+
+        pos = next_line;
         line_num++;
         // reset line number when we come to the end of a street
-        line_num = (num_segs != 0 && line_num - 2 == num_segs) ? 0 : line_num;
+        line_num = (line_num - 2 > num_segs) ? 1 : line_num;
     }
-    
-    map_data_file.close();
+
+    // give every distinct end point a dense id by sorting the node table
+    vector<FixedCoord>& nodes = m_owned_nodes;
+    nodes.reserve(2*raw_segs.size());
+    for(const RawSegment& seg : raw_segs)
+    {
+        nodes.push_back(seg.start);
+        nodes.push_back(seg.end);
+    }
+    sort(nodes.begin(), nodes.end());
+    nodes.erase(unique(nodes.begin(), nodes.end()), nodes.end());
+
+    // each segment is usable in both directions, so it's stored once as an
+    // edge leaving each of its end points; a counting sort keeps every node's
+    // edges in the order they appear in the file
+    auto node_of = [&nodes](const FixedCoord& coord) {
+        return uint32_t(lower_bound(nodes.begin(), nodes.end(), coord) - nodes.begin());
+    };
+    vector<uint32_t> seg_starts(raw_segs.size()), seg_ends(raw_segs.size());
+    vector<uint32_t>& offsets = m_owned_edge_offsets;
+    offsets.assign(nodes.size() + 1, 0);
+    for(size_t i = 0; i < raw_segs.size(); i++)
+    {
+        seg_starts[i] = node_of(raw_segs[i].start);
+        seg_ends[i] = node_of(raw_segs[i].end);
+        offsets[seg_starts[i] + 1]++;
+        offsets[seg_ends[i] + 1]++;
+    }
+    for(size_t i = 1; i < offsets.size(); i++)
+        offsets[i] += offsets[i - 1];
+
+    vector<uint32_t> fill_pos(offsets.begin(), offsets.end() - 1);
+    m_owned_edge_targets.resize(2*raw_segs.size());
+    m_owned_edge_lengths.resize(2*raw_segs.size());
+    m_owned_edge_names.resize(2*raw_segs.size());
+    for(size_t i = 0; i < raw_segs.size(); i++)
+    {
+        uint32_t forward = fill_pos[seg_starts[i]]++, backward = fill_pos[seg_ends[i]]++;
+        m_owned_edge_targets[forward] = seg_ends[i];
+        m_owned_edge_targets[backward] = seg_starts[i];
+        m_owned_edge_lengths[forward] = m_owned_edge_lengths[backward]
+            = distanceEarthMiles(raw_segs[i].start, raw_segs[i].end);
+        m_owned_edge_names[forward] = m_owned_edge_names[backward] = raw_segs[i].name;
+    }
+
+    m_owned_name_offsets.swap(name_offsets);
+    m_owned_names.swap(names);
+    UseOwnedArrays();
     return true;
 }
 
+bool StreetMapImpl::LoadCompiled(const string& compiled_map_path)
+{
+    int fd = open(compiled_map_path.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+    struct stat file_info;
+    if(fstat(fd, &file_info) != 0 || size_t(file_info.st_size) < sizeof(CompiledMapHeader))
+    {
+        close(fd);
+        return false;
+    }
+    size_t file_size = size_t(file_info.st_size);
+    // a shared read-only mapping lets every process using this map share
+    // the same page cache pages
+    void* mapping = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED)
+        return false;
+
+    const char* base = static_cast<const char*>(mapping);
+    CompiledMapHeader header;
+    memcpy(&header, base, sizeof(header));
+
+    // checks that a section lies inside the file and is suitably aligned
+    auto section_ok = [&](uint64_t offset, uint64_t count, uint64_t elem_size) {
+        return offset % 8 == 0 && offset >= sizeof(header) && offset <= file_size
+            && count <= (file_size - offset) / elem_size;
+    };
+    bool valid = memcmp(header.magic, COMPILED_MAP_MAGIC, sizeof(header.magic)) == 0
+        && header.version == COMPILED_MAP_VERSION
+        && header.endian_tag == COMPILED_MAP_ENDIAN_TAG
+        && header.header_size == sizeof(header)
+        && header.file_size == file_size
+        && section_ok(header.nodes_offset, header.num_nodes, sizeof(FixedCoord))
+        && section_ok(header.edge_offsets_offset, uint64_t(header.num_nodes) + 1, sizeof(uint32_t))
+        && section_ok(header.edge_targets_offset, header.num_edges, sizeof(uint32_t))
+        && section_ok(header.edge_lengths_offset, header.num_edges, sizeof(double))
+        && section_ok(header.edge_names_offset, header.num_edges, sizeof(uint32_t))
+        && section_ok(header.name_offsets_offset, uint64_t(header.num_names) + 1, sizeof(uint32_t))
+        && section_ok(header.names_offset, header.name_bytes, 1)
+        && mapChecksum(base + sizeof(header), file_size - sizeof(header)) == header.checksum;
+    if(valid)
+    {
+        const uint32_t* edge_offsets = reinterpret_cast<const uint32_t*>(base + header.edge_offsets_offset);
+        const uint32_t* name_offsets = reinterpret_cast<const uint32_t*>(base + header.name_offsets_offset);
+        valid = edge_offsets[header.num_nodes] == header.num_edges
+            && name_offsets[header.num_names] == header.name_bytes;
+    }
+    if(!valid)
+    {
+        munmap(mapping, file_size);
+        return false;
+    }
+
+    m_mapping = mapping;
+    m_mapping_size = file_size;
+    m_nodes = reinterpret_cast<const FixedCoord*>(base + header.nodes_offset);
+    m_edge_offsets = reinterpret_cast<const uint32_t*>(base + header.edge_offsets_offset);
+    m_edge_targets = reinterpret_cast<const uint32_t*>(base + header.edge_targets_offset);
+    m_edge_lengths = reinterpret_cast<const double*>(base + header.edge_lengths_offset);
+    m_edge_names = reinterpret_cast<const uint32_t*>(base + header.edge_names_offset);
+    m_name_offsets = reinterpret_cast<const uint32_t*>(base + header.name_offsets_offset);
+    m_names = base + header.names_offset;
+    m_num_nodes = header.num_nodes;
+    m_num_edges = header.num_edges;
+    m_num_names = header.num_names;
+    m_name_bytes = header.name_bytes;
+    return true;
+}
+
+bool StreetMapImpl::Compile(string compiled_map_path) const
+{
+    CompiledMapHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, COMPILED_MAP_MAGIC, sizeof(header.magic));
+    header.version = COMPILED_MAP_VERSION;
+    header.endian_tag = COMPILED_MAP_ENDIAN_TAG;
+    header.header_size = sizeof(header);
+    header.num_nodes = m_num_nodes;
+    header.num_edges = m_num_edges;
+    header.num_names = m_num_names;
+    header.name_bytes = m_name_bytes;
+
+    // lay the sections out back to back, each padded to 8 bytes
+    string payload;
+    auto append_section = [&payload, &header](const void* data, size_t num_bytes) {
+        payload.append((8 - payload.size() % 8) % 8, '\0');
+        uint64_t offset = sizeof(header) + payload.size();
+        payload.append(static_cast<const char*>(data), num_bytes);
+        return offset;
+    };
+    header.nodes_offset = append_section(m_nodes, m_num_nodes*sizeof(FixedCoord));
+    header.edge_offsets_offset = append_section(m_edge_offsets, (m_num_nodes + 1)*sizeof(uint32_t));
+    header.edge_targets_offset = append_section(m_edge_targets, m_num_edges*sizeof(uint32_t));
+    header.edge_lengths_offset = append_section(m_edge_lengths, m_num_edges*sizeof(double));
+    header.edge_names_offset = append_section(m_edge_names, m_num_edges*sizeof(uint32_t));
+    header.name_offsets_offset = append_section(m_name_offsets, (m_num_names + 1)*sizeof(uint32_t));
+    header.names_offset = append_section(m_names, m_name_bytes);
+    header.file_size = sizeof(header) + payload.size();
+    header.checksum = mapChecksum(payload.data(), payload.size());
+
+    ofstream compiled_file(compiled_map_path, ios::binary | ios::trunc);
+    if(!compiled_file)
+        return false;
+    compiled_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    compiled_file.write(payload.data(), payload.size());
+    return bool(compiled_file);
+}
+
 bool StreetMapImpl::GetSegmentsThatStartWith(const GeoCoord& gc, vector<StreetSegment>& segs) const
 {
-    const vector<StreetSegment> *segVecPtr = m_coord_seg_map.Find(gc);
-    if(segVecPtr != nullptr)
-        segs = *segVecPtr;
-    return (bool(segVecPtr));  
+    NodeId node;
+    if(!FindNode(gc, node))
+        return false;
+
+    GeoCoord start = NodeCoord(node);
+    segs.clear();
+    for(StreetEdge edge : Neighbors(node))
+        segs.emplace_back(start, NodeCoord(edge.target), StreetName(edge.street));
+    return true;
+}
+
+void StreetMapImpl::Unload()
+{
+    if(m_mapping != nullptr)
+        munmap(m_mapping, m_mapping_size);
+    m_mapping = nullptr;
+    m_mapping_size = 0;
+
+    m_owned_nodes.clear();
+    m_owned_edge_offsets.assign(1, 0);
+    m_owned_edge_targets.clear();
+    m_owned_edge_lengths.clear();
+    m_owned_edge_names.clear();
+    m_owned_name_offsets.assign(1, 0);
+    m_owned_names.clear();
+    UseOwnedArrays();
+
+    m_grid_rows = m_grid_cols = 0;
+    m_cell_node_offsets.clear();
+    m_cell_nodes.clear();
+    m_cell_segment_offsets.clear();
+    m_cell_segments.clear();
+}
+
+void StreetMapImpl::UseOwnedArrays()
+{
+    if(m_owned_edge_offsets.empty())
+        m_owned_edge_offsets.assign(1, 0);
+    if(m_owned_name_offsets.empty())
+        m_owned_name_offsets.assign(1, 0);
+    m_nodes = m_owned_nodes.data();
+    m_edge_offsets = m_owned_edge_offsets.data();
+    m_edge_targets = m_owned_edge_targets.data();
+    m_edge_lengths = m_owned_edge_lengths.data();
+    m_edge_names = m_owned_edge_names.data();
+    m_name_offsets = m_owned_name_offsets.data();
+    m_names = m_owned_names.data();
+    m_num_nodes = uint32_t(m_owned_nodes.size());
+    m_num_edges = uint32_t(m_owned_edge_targets.size());
+    m_num_names = uint32_t(m_owned_name_offsets.size() - 1);
+    m_name_bytes = m_owned_names.size();
+}
+
+bool StreetMapImpl::FindNode(const GeoCoord& gc, NodeId& node) const
+{
+    FixedCoord coord;
+    if(!parseFixedCoord(gc.latitudeText, coord.lat) || !parseFixedCoord(gc.longitudeText, coord.lon))
+        return false;
+    const FixedCoord* found = lower_bound(m_nodes, m_nodes + m_num_nodes, coord);
+    if(found == m_nodes + m_num_nodes || !(*found == coord))
+        return false;
+    node = NodeId(found - m_nodes);
+    return true;
+}
+
+GeoCoord StreetMapImpl::NodeCoord(NodeId node) const
+{
+    return GeoCoord(fixedCoordText(m_nodes[node].lat), fixedCoordText(m_nodes[node].lon));
+}
+
+string StreetMapImpl::StreetName(uint32_t name) const
+{
+    return string(m_names + m_name_offsets[name], m_names + m_name_offsets[name + 1]);
 }
 
-void StreetMapImpl::AppendSegToMap(GeoCoord coord, StreetSegment seg)
+uint64_t StreetMapImpl::Fingerprint() const
 {
-    vector<StreetSegment>* mappedSegs = m_coord_seg_map.Find(coord);
-    // if the coordinate is already in the map, add the adjoining street
-    if(mappedSegs != nullptr)
-        mappedSegs -> push_back(seg);
-    else
+    // combine the checksums of the arrays that make up the graph
+    uint64_t sums[5] = {
+        mapChecksum(m_nodes, m_num_nodes*sizeof(FixedCoord)),
+        mapChecksum(m_edge_offsets, (m_num_nodes + 1)*sizeof(uint32_t)),
+        mapChecksum(m_edge_targets, m_num_edges*sizeof(uint32_t)),
+        mapChecksum(m_edge_lengths, m_num_edges*sizeof(double)),
+        mapChecksum(m_edge_names, m_num_edges*sizeof(uint32_t))
+    };
+    return mapChecksum(sums, sizeof(sums));
+}
+
+void StreetMapImpl::BuildGrid()
+{
+    if(m_num_nodes == 0)
+        return;
+    FixedCoord low = m_nodes[0], high = m_nodes[0];
+    for(NodeId node = 0; node < m_num_nodes; node++)
+    {
+        low.lat = min(low.lat, m_nodes[node].lat);
+        low.lon = min(low.lon, m_nodes[node].lon);
+        high.lat = max(high.lat, m_nodes[node].lat);
+        high.lon = max(high.lon, m_nodes[node].lon);
+    }
+    m_grid_corner = low;
+    m_grid_cos_lat = cos(deg2rad(fixedCoordDegrees(low.lat) / 2 + fixedCoordDegrees(high.lat) / 2));
+
+    // square cells, about one for every two segments (every segment is two
+    // edges); no side gets more cells than that, for maps that are long and
+    // thin
+    double height = double(high.lat) - low.lat + 1;
+    double width = (double(high.lon) - low.lon + 1)*m_grid_cos_lat;
+    double num_cells = max(1.0, m_num_edges / 4.0);
+    m_cell_size = max(sqrt(height*width/num_cells), max(height, width)/num_cells);
+    m_grid_rows = uint32_t(height/m_cell_size) + 1;
+    m_grid_cols = uint32_t(width/m_cell_size) + 1;
+    const size_t total_cells = size_t(m_grid_rows)*m_grid_cols;
+
+    // each node goes in the cell it's in, by a counting sort
+    vector<uint32_t> node_cells(m_num_nodes);
+    m_cell_node_offsets.assign(total_cells + 1, 0);
+    for(NodeId node = 0; node < m_num_nodes; node++)
     {
-        vector<StreetSegment> new_segs;
-        new_segs.push_back(seg);
-        m_coord_seg_map.Associate(seg.start, new_segs);
+        double x, y;
+        GridPosition(m_nodes[node], x, y);
+        node_cells[node] = GridCell(x, y);
+        m_cell_node_offsets[node_cells[node] + 1]++;
     }
+    for(size_t i = 1; i <= total_cells; i++)
+        m_cell_node_offsets[i] += m_cell_node_offsets[i - 1];
+    vector<uint32_t> fill_pos(m_cell_node_offsets.begin(), m_cell_node_offsets.end() - 1);
+    m_cell_nodes.resize(m_num_nodes);
+    for(NodeId node = 0; node < m_num_nodes; node++)
+        m_cell_nodes[fill_pos[node_cells[node]]++] = node;
+
+    // each segment, by its edge from the lower numbered end, goes in every
+    // cell its bounding box overlaps; the first pass counts, the second fills
+    m_cell_segment_offsets.assign(total_cells + 1, 0);
+    for(int pass = 0; pass < 2; pass++)
+    {
+        for(NodeId from = 0; from < m_num_nodes; from++)
+            for(EdgeId edge = m_edge_offsets[from]; edge < m_edge_offsets[from + 1]; edge++)
+            {
+                NodeId to = m_edge_targets[edge];
+                if(to <= from)
+                    continue;
+                uint32_t to_cell = node_cells[to];
+                uint32_t row_lo = min(node_cells[from] / m_grid_cols, to_cell / m_grid_cols);
+                uint32_t row_hi = max(node_cells[from] / m_grid_cols, to_cell / m_grid_cols);
+                uint32_t col_lo = min(node_cells[from] % m_grid_cols, to_cell % m_grid_cols);
+                uint32_t col_hi = max(node_cells[from] % m_grid_cols, to_cell % m_grid_cols);
+                for(uint32_t row = row_lo; row <= row_hi; row++)
+                    for(uint32_t col = col_lo; col <= col_hi; col++)
+                    {
+                        uint32_t cell = row*m_grid_cols + col;
+                        if(pass == 0)
+                            m_cell_segment_offsets[cell + 1]++;
+                        else
+                            m_cell_segments[fill_pos[cell]++] = GridSegment{from, edge};
+                    }
+            }
+        if(pass == 0)
+        {
+            for(size_t i = 1; i <= total_cells; i++)
+                m_cell_segment_offsets[i] += m_cell_segment_offsets[i - 1];
+            fill_pos.assign(m_cell_segment_offsets.begin(), m_cell_segment_offsets.end() - 1);
+            m_cell_segments.resize(m_cell_segment_offsets.back());
+        }
+    }
+}
+
+void StreetMapImpl::GridPosition(const FixedCoord& coord, double& x, double& y) const
+{
+    x = (double(coord.lon) - m_grid_corner.lon)*m_grid_cos_lat;
+    y = double(coord.lat) - m_grid_corner.lat;
+}
+
+uint32_t StreetMapImpl::GridCell(double x, double y) const
+{
+    // points off the grid belong to the nearest cell on its edge
+    uint32_t row = uint32_t(min(double(m_grid_rows - 1), max(0.0, floor(y/m_cell_size))));
+    uint32_t col = uint32_t(min(double(m_grid_cols - 1), max(0.0, floor(x/m_cell_size))));
+    return row*m_grid_cols + col;
+}
+
+template<typename Visit>
+void StreetMapImpl::SearchGrid(double x, double y, const double& best, Visit visit_cell) const
+{
+    const uint32_t start = GridCell(x, y);
+    const int64_t row0 = start / m_grid_cols, col0 = start % m_grid_cols;
+    const int64_t rows = m_grid_rows, cols = m_grid_cols;
+    for(int64_t ring = 0; ; ring++)
+    {
+        const int64_t row_lo = row0 - ring, row_hi = row0 + ring;
+        const int64_t col_lo = col0 - ring, col_hi = col0 + ring;
+        for(int64_t row = max<int64_t>(row_lo, 0); row <= min(row_hi, rows - 1); row++)
+        {
+            if(row == row_lo || row == row_hi)
+            {
+                for(int64_t col = max<int64_t>(col_lo, 0); col <= min(col_hi, cols - 1); col++)
+                    visit_cell(uint32_t(row*cols + col));
+                continue;
+            }
+            if(col_lo >= 0)
+                visit_cell(uint32_t(row*cols + col_lo));
+            if(col_hi < cols)
+                visit_cell(uint32_t(row*cols + col_hi));
+        }
+
+        // the nearest a cell outside the rings so far can be is the nearest
+        // of their sides with more of the grid beyond it
+        double reach = numeric_limits<double>::infinity();
+        if(row_lo > 0)
+            reach = min(reach, y - row_lo*m_cell_size);
+        if(row_hi < rows - 1)
+            reach = min(reach, (row_hi + 1)*m_cell_size - y);
+        if(col_lo > 0)
+            reach = min(reach, x - col_lo*m_cell_size);
+        if(col_hi < cols - 1)
+            reach = min(reach, (col_hi + 1)*m_cell_size - x);
+        if(best <= reach)
+            return;
+    }
+}
+
+bool StreetMapImpl::SnapToStreet(const GeoCoord& gc, StreetSnap& snap) const
+{
+    FixedCoord at;
+    if(m_cell_segments.empty()
+       || !parseFixedCoord(gc.latitudeText, at.lat) || !parseFixedCoord(gc.longitudeText, at.lon))
+        return false;
+    double x, y;
+    GridPosition(at, x, y);
+
+    // a segment may be in several cells, and is simply measured again
+    double best = numeric_limits<double>::infinity();
+    GridSegment best_segment = {0, 0};
+    double best_fraction = 0;
+    SearchGrid(x, y, best, [&](uint32_t cell) {
+        for(uint32_t i = m_cell_segment_offsets[cell]; i < m_cell_segment_offsets[cell + 1]; i++)
+        {
+            const GridSegment& segment = m_cell_segments[i];
+            double from_x, from_y, to_x, to_y;
+            GridPosition(m_nodes[segment.from], from_x, from_y);
+            GridPosition(m_nodes[m_edge_targets[segment.edge]], to_x, to_y);
+            double dx = to_x - from_x, dy = to_y - from_y;
+            double length_squared = dx*dx + dy*dy;
+            double fraction = (length_squared == 0) ? 0
+                : min(1.0, max(0.0, ((x - from_x)*dx + (y - from_y)*dy) / length_squared));
+            double distance = hypot(from_x + fraction*dx - x, from_y + fraction*dy - y);
+            if(distance < best)
+            {
+                best = distance;
+                best_segment = segment;
+                best_fraction = fraction;
+            }
+        }
+    });
+
+    const FixedCoord from = m_nodes[best_segment.from];
+    const FixedCoord to = m_nodes[m_edge_targets[best_segment.edge]];
+    FixedCoord point;
+    point.lat = int32_t(llround(from.lat + best_fraction*(double(to.lat) - from.lat)));
+    point.lon = int32_t(llround(from.lon + best_fraction*(double(to.lon) - from.lon)));
+    snap.edge = best_segment.edge;
+    snap.from = best_segment.from;
+    snap.to = m_edge_targets[best_segment.edge];
+    snap.fraction = best_fraction;
+    snap.point = GeoCoord(fixedCoordText(point.lat), fixedCoordText(point.lon));
+    snap.distance = distanceEarthMiles(at, point);
+    return true;
+}
+
+bool StreetMapImpl::NearestNode(const GeoCoord& gc, NodeId& node) const
+{
+    FixedCoord at;
+    if(m_cell_nodes.empty()
+       || !parseFixedCoord(gc.latitudeText, at.lat) || !parseFixedCoord(gc.longitudeText, at.lon))
+        return false;
+    double x, y;
+    GridPosition(at, x, y);
+
+    double best = numeric_limits<double>::infinity();
+    SearchGrid(x, y, best, [&](uint32_t cell) {
+        for(uint32_t i = m_cell_node_offsets[cell]; i < m_cell_node_offsets[cell + 1]; i++)
+        {
+            double node_x, node_y;
+            GridPosition(m_nodes[m_cell_nodes[i]], node_x, node_y);
+            double distance = hypot(node_x - x, node_y - y);
+            if(distance < best)
+            {
+                best = distance;
+                node = m_cell_nodes[i];
+            }
+        }
+    });
+    return true;
+}
+
+bool StreetMapImpl::SnapToNode(const GeoCoord& gc, NodeId& node, double max_miles) const
+{
+    if(FindNode(gc, node))
+        return true;
+    StreetSnap snap;
+    if(!SnapToStreet(gc, snap) || snap.distance > max_miles)
+        return false;
+    node = (snap.fraction <= 0.5) ? snap.from : snap.to;
+    return true;
 }
 
 // Functions added by Professors Nachenburg and Smallberg for grading purposes
@@ -143,7 +740,77 @@ bool StreetMap::load(string map_data_path)
     return m_impl->Load(map_data_path);
 }
 
+bool StreetMap::compile(string compiled_map_path) const
+{
+    return m_impl->Compile(compiled_map_path);
+}
+
 bool StreetMap::GetSegmentsThatStartWith(const GeoCoord& gc, vector<StreetSegment>& segs) const
 {
    return m_impl->GetSegmentsThatStartWith(gc, segs);
 }
+
+NodeId StreetMap::NodeCount() const
+{
+    return m_impl->NodeCount();
+}
+
+bool StreetMap::FindNode(const GeoCoord& gc, NodeId& node) const
+{
+    return m_impl->FindNode(gc, node);
+}
+
+GeoCoord StreetMap::NodeCoord(NodeId node) const
+{
+    return m_impl->NodeCoord(node);
+}
+
+FixedCoord StreetMap::NodeFixedCoord(NodeId node) const
+{
+    return m_impl->NodeFixedCoord(node);
+}
+
+EdgeRange StreetMap::Neighbors(NodeId node) const
+{
+    return m_impl->Neighbors(node);
+}
+
+NodeId StreetMap::EdgeTarget(EdgeId edge) const
+{
+    return m_impl->EdgeTarget(edge);
+}
+
+double StreetMap::EdgeLength(EdgeId edge) const
+{
+    return m_impl->EdgeLength(edge);
+}
+
+uint32_t StreetMap::EdgeStreet(EdgeId edge) const
+{
+    return m_impl->EdgeStreet(edge);
+}
+
+string StreetMap::StreetName(uint32_t street) const
+{
+    return m_impl->StreetName(street);
+}
+
+uint64_t StreetMap::Fingerprint() const
+{
+    return m_impl->Fingerprint();
+}
+
+bool StreetMap::SnapToStreet(const GeoCoord& gc, StreetSnap& snap) const
+{
+    return m_impl->SnapToStreet(gc, snap);
+}
+
+bool StreetMap::NearestNode(const GeoCoord& gc, NodeId& node) const
+{
+    return m_impl->NearestNode(gc, node);
+}
+
+bool StreetMap::SnapToNode(const GeoCoord& gc, NodeId& node, double maxMiles) const
+{
+    return m_impl->SnapToNode(gc, node, maxMiles);
+}
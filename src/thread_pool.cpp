@@ -0,0 +1,162 @@
+//  Author:  Noah Himed
+//  Date:    16 October 2026
+//  Summary: Implements the work-stealing thread pool and task groups.
+
+#include "thread_pool.h"
+
+#include <chrono>
+
+using namespace std;
+
+namespace
+{
+    // the pool the calling thread works for, and its queue in that pool
+    thread_local ThreadPool* t_pool = nullptr;
+    thread_local unsigned t_queue = 0;
+}
+
+ThreadPool::ThreadPool(unsigned num_threads)
+: m_num_queued(0), m_next_queue(0), m_stopping(false)
+{
+    if(num_threads == 0)
+        num_threads = max(1u, thread::hardware_concurrency());
+    for(unsigned i = 0; i < num_threads; i++)
+        m_queues.emplace_back(new WorkQueue);
+    for(unsigned i = 0; i < num_threads; i++)
+        m_threads.emplace_back(&ThreadPool::WorkerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> sleep_guard(m_sleep_lock);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for(thread& worker : m_threads)
+        worker.join();
+}
+
+ThreadPool& ThreadPool::Shared()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::Submit(Task task)
+{
+    unsigned queue = (t_pool == this) ? t_queue : m_next_queue++ % unsigned(m_queues.size());
+    {
+        lock_guard<mutex> queue_guard(m_queues[queue]->lock);
+        m_queues[queue]->tasks.push_back(move(task));
+    }
+    // counted under the sleep lock, so a worker can't check for work and
+    // then miss this wake-up on its way to sleep
+    {
+        lock_guard<mutex> sleep_guard(m_sleep_lock);
+        m_num_queued++;
+    }
+    m_wake.notify_one();
+}
+
+bool ThreadPool::RunOneTask()
+{
+    if(m_num_queued == 0)
+        return false;
+
+    const unsigned num_queues = unsigned(m_queues.size());
+    const bool is_worker = (t_pool == this);
+    const unsigned first = is_worker ? t_queue : m_next_queue % num_queues;
+    Task task;
+    for(unsigned i = 0; i < num_queues && !task; i++)
+    {
+        WorkQueue& queue = *m_queues[(first + i) % num_queues];
+        lock_guard<mutex> queue_guard(queue.lock);
+        if(queue.tasks.empty())
+            continue;
+        // newest from our own queue, oldest from anyone else's
+        if(i == 0 && is_worker)
+        {
+            task = move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        else
+        {
+            task = move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+    }
+    if(!task)
+        return false;
+    m_num_queued--;
+    task();
+    return true;
+}
+
+void ThreadPool::WorkerLoop(unsigned index)
+{
+    t_pool = this;
+    t_queue = index;
+    for(;;)
+    {
+        if(RunOneTask())
+            continue;
+        unique_lock<mutex> sleep_guard(m_sleep_lock);
+        m_wake.wait(sleep_guard, [this]() { return m_stopping || m_num_queued > 0; });
+        if(m_stopping && m_num_queued == 0)
+            return;
+    }
+}
+
+TaskGroup::TaskGroup(ThreadPool& pool)
+: m_pool(pool), m_num_pending(0)
+{}
+
+TaskGroup::~TaskGroup()
+{
+    Wait();
+}
+
+void TaskGroup::Run(function<void()> task)
+{
+    {
+        lock_guard<mutex> guard(m_lock);
+        m_num_pending++;
+    }
+    m_pool.Submit([this, task]() {
+        task();
+        // the group may be destroyed as soon as its waiter sees the count
+        // reach zero, so nothing of it is touched after this lock is released
+        lock_guard<mutex> guard(m_lock);
+        if(--m_num_pending == 0)
+            m_done.notify_all();
+    });
+}
+
+void TaskGroup::Wait()
+{
+    unique_lock<mutex> guard(m_lock);
+    while(m_num_pending > 0)
+    {
+        // help with queued work, which may well be this group's own, and
+        // only sleep when there's none to take
+        guard.unlock();
+        bool ran_task = m_pool.RunOneTask();
+        guard.lock();
+        if(!ran_task && m_num_pending > 0)
+            m_done.wait_for(guard, chrono::milliseconds(1));
+    }
+}
+
+void parallelFor(size_t count, const function<void(size_t)>& body)
+{
+    if(count == 1)
+    {
+        body(0);
+        return;
+    }
+    TaskGroup group;
+    for(size_t i = 0; i < count; i++)
+        group.Run([&body, i]() { body(i); });
+    group.Wait();
+}
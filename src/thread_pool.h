@@ -0,0 +1,88 @@
+//  Author:  Noah Himed
+//  Date:    16 October 2026
+//  Summary: A work-stealing thread pool for running independent routing
+//           work, such as distance matrix rows or the legs of a plan, on
+//           every core.
+
+#ifndef THREAD_POOL_INCLUDED
+#define THREAD_POOL_INCLUDED
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Each worker keeps its own queue of tasks. A worker takes its newest task
+// first, which tends to still be in its cache, and when it runs out steals
+// the oldest task from another worker, so a thread that gets ahead never
+// sits idle while others have work queued.
+class ThreadPool
+{
+public:
+    // starts num_threads workers, or one per core if num_threads is 0
+    explicit ThreadPool(unsigned num_threads = 0);
+    // runs every task still queued, then stops the workers
+    ~ThreadPool();
+    unsigned ThreadCount() const { return unsigned(m_threads.size()); }
+
+    // the pool shared by everything in the process that runs in parallel
+    static ThreadPool& Shared();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+private:
+    friend class TaskGroup;
+    typedef std::function<void()> Task;
+    struct WorkQueue
+    {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    // queues a task on the calling worker's own queue, or spread over the
+    // workers' queues when called from outside the pool
+    void Submit(Task task);
+    // runs one queued task on the calling thread, if any task is queued
+    bool RunOneTask();
+    void WorkerLoop(unsigned index);
+
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+    std::vector<std::thread> m_threads;
+    std::atomic<std::size_t> m_num_queued;
+    std::atomic<unsigned> m_next_queue;
+    // idle workers sleep on m_wake until a task is queued or the pool stops
+    std::mutex m_sleep_lock;
+    std::condition_variable m_wake;
+    bool m_stopping;
+};
+
+// A set of tasks run on a pool and waited for together. A thread waiting on
+// a group runs queued tasks itself until the group is done, so groups may be
+// nested inside tasks without tying up the pool's workers.
+class TaskGroup
+{
+public:
+    explicit TaskGroup(ThreadPool& pool = ThreadPool::Shared());
+    ~TaskGroup();
+    void Run(std::function<void()> task);
+    void Wait();
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+private:
+    ThreadPool& m_pool;
+    std::size_t m_num_pending;
+    std::mutex m_lock;
+    std::condition_variable m_done;
+};
+
+// runs body(i) for every i below count on the shared pool, returning once
+// all of them have run
+void parallelFor(std::size_t count, const std::function<void(std::size_t)>& body);
+
+#endif // THREAD_POOL_INCLUDED
@@ -0,0 +1,930 @@
+//  Author:  Noah Himed
+//  Date:    16 October 2026
+//  Summary: Implements the candidate lists, Hilbert curve ordering, array
+//           tour and 2-opt / Or-opt local search used by the
+//           DeliveryOptimizer's tour search engines.
+
+#include "tour_search.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <queue>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+// moves must save more than this to be taken, so rounding can't make the
+// search go round in circles
+const double MIN_IMPROVEMENT = 1e-10;
+
+// the longest run of points an Or-opt move carries elsewhere
+const int MAX_OR_OPT_LENGTH = 3;
+
+// how many points the local search looks at between looks at the clock
+const int POINTS_PER_DEADLINE_CHECK = 256;
+
+// Positions of points on a plane, in degrees of latitude, with longitude
+// shrunk by the cosine of the points' mean latitude. Close enough to true
+// distances over a city to decide which points are near one another.
+static void planarPositions(const vector<GeoCoord>& points, vector<double>& x, vector<double>& y)
+{
+    double mean_lat = 0;
+    for(const GeoCoord& point : points)
+        mean_lat += point.latitude;
+    if(!points.empty())
+        mean_lat /= points.size();
+    const double lon_scale = cos(deg2rad(mean_lat));
+    x.resize(points.size());
+    y.resize(points.size());
+    for(size_t i = 0; i < points.size(); i++)
+    {
+        x[i] = points[i].longitude*lon_scale;
+        y[i] = points[i].latitude;
+    }
+}
+
+TourCosts TourCosts::Subset(const vector<int>& indices) const
+{
+    vector<GeoCoord> points;
+    for(int i : indices)
+        points.push_back(m_points[i]);
+    TourCosts subset(points);
+    if(HasMatrix())
+    {
+        vector<double> matrix;
+        matrix.reserve(indices.size()*indices.size());
+        for(int from : indices)
+            for(int to : indices)
+                matrix.push_back((*this)(from, to));
+        subset.UseMatrix(matrix);
+    }
+    return subset;
+}
+
+CandidateLists::CandidateLists(const TourCosts& costs, int num_candidates)
+{
+    const vector<GeoCoord>& points = costs.Points();
+    const int num_points = int(points.size());
+    m_num_candidates = size_t(max(0, min(num_candidates, num_points - 1)));
+    m_candidates.resize(m_num_candidates*num_points);
+    if(m_num_candidates == 0)
+        return;
+
+    // bucket the points into a grid of about two points per cell
+    vector<double> x, y;
+    planarPositions(points, x, y);
+    const double min_x = *min_element(x.begin(), x.end()), min_y = *min_element(y.begin(), y.end());
+    const double width = *max_element(x.begin(), x.end()) - min_x;
+    const double height = *max_element(y.begin(), y.end()) - min_y;
+    const double target_cells = max(1.0, num_points/2.0);
+    double cell_size = sqrt(width*height/target_cells);
+    if(!(cell_size > 0))
+        cell_size = max(width, height)/target_cells;
+    if(!(cell_size > 0))
+        cell_size = 1;
+    const int num_cols = int(width/cell_size) + 1, num_rows = int(height/cell_size) + 1;
+    auto col_of = [&](int point) { return min(num_cols - 1, int((x[point] - min_x)/cell_size)); };
+    auto row_of = [&](int point) { return min(num_rows - 1, int((y[point] - min_y)/cell_size)); };
+
+    vector<int> cell_start(size_t(num_cols)*num_rows + 1, 0), cell_points(num_points);
+    for(int point = 0; point < num_points; point++)
+        cell_start[size_t(row_of(point))*num_cols + col_of(point) + 1]++;
+    for(size_t cell = 1; cell < cell_start.size(); cell++)
+        cell_start[cell] += cell_start[cell - 1];
+    vector<int> fill(cell_start.begin(), cell_start.end() - 1);
+    for(int point = 0; point < num_points; point++)
+        cell_points[fill[size_t(row_of(point))*num_cols + col_of(point)]++] = point;
+
+    // search rings of cells outward from each point's own cell; once the
+    // nearest points found are closer than anything in the next ring
+    // could be, they're the nearest there are
+    typedef pair<double, int> Found;
+    priority_queue<Found> nearest;
+    vector<pair<double, int>> by_cost;
+    for(int point = 0; point < num_points; point++)
+    {
+        const int col = col_of(point), row = row_of(point);
+        for(int ring = 0; ring <= max(num_cols, num_rows); ring++)
+        {
+            for(int r = row - ring; r <= row + ring; r++)
+            {
+                if(r < 0 || r >= num_rows)
+                    continue;
+                // the middle rows of a ring only have cells at its two sides
+                int step = (r == row - ring || r == row + ring) ? 1 : max(1, 2*ring);
+                for(int c = col - ring; c <= col + ring; c += step)
+                {
+                    if(c < 0 || c >= num_cols)
+                        continue;
+                    size_t cell = size_t(r)*num_cols + c;
+                    for(int i = cell_start[cell]; i < cell_start[cell + 1]; i++)
+                    {
+                        int other = cell_points[i];
+                        if(other == point)
+                            continue;
+                        double dx = x[other] - x[point], dy = y[other] - y[point];
+                        double dist = dx*dx + dy*dy;
+                        if(nearest.size() < m_num_candidates)
+                            nearest.emplace(dist, other);
+                        else if(dist < nearest.top().first)
+                        {
+                            nearest.pop();
+                            nearest.emplace(dist, other);
+                        }
+                    }
+                }
+            }
+            double reach = ring*cell_size;
+            if(nearest.size() == m_num_candidates && nearest.top().first <= reach*reach)
+                break;
+        }
+
+        // order the candidates found by their actual cost
+        by_cost.clear();
+        for(; !nearest.empty(); nearest.pop())
+            by_cost.emplace_back(costs(point, nearest.top().second), nearest.top().second);
+        sort(by_cost.begin(), by_cost.end());
+        for(size_t i = 0; i < m_num_candidates; i++)
+            m_candidates[size_t(point)*m_num_candidates + i] = by_cost[i].second;
+    }
+}
+
+// the distance along a Hilbert curve filling a 65536 by 65536 grid to the
+// cell (x, y)
+static uint64_t hilbertIndex(uint32_t x, uint32_t y)
+{
+    const uint32_t side = 1u << 16;
+    uint64_t index = 0;
+    for(uint32_t s = side/2; s > 0; s /= 2)
+    {
+        uint32_t rx = (x & s) ? 1 : 0, ry = (y & s) ? 1 : 0;
+        index += uint64_t(s)*s*((3*rx) ^ ry);
+        // turn the quadrant so the curve inside it runs the right way
+        if(ry == 0)
+        {
+            if(rx == 1)
+            {
+                x = side - 1 - x;
+                y = side - 1 - y;
+            }
+            swap(x, y);
+        }
+    }
+    return index;
+}
+
+vector<int> hilbertOrder(const vector<GeoCoord>& points)
+{
+    vector<int> order(points.size());
+    if(points.empty())
+        return order;
+    vector<double> x, y;
+    planarPositions(points, x, y);
+    const double min_x = *min_element(x.begin(), x.end()), min_y = *min_element(y.begin(), y.end());
+    double extent = max(*max_element(x.begin(), x.end()) - min_x, *max_element(y.begin(), y.end()) - min_y);
+    if(!(extent > 0))
+        extent = 1;
+
+    vector<pair<uint64_t, int>> keyed(points.size());
+    for(size_t i = 0; i < points.size(); i++)
+    {
+        uint32_t cell_x = uint32_t((x[i] - min_x)/extent*65535.0);
+        uint32_t cell_y = uint32_t((y[i] - min_y)/extent*65535.0);
+        keyed[i] = make_pair(hilbertIndex(cell_x, cell_y), int(i));
+    }
+    sort(keyed.begin(), keyed.end());
+    for(size_t i = 0; i < keyed.size(); i++)
+        order[i] = keyed[i].second;
+    return order;
+}
+
+ArrayTour::ArrayTour(const vector<int>& order)
+: m_order(order), m_pos(order.size())
+{
+    for(size_t i = 0; i < order.size(); i++)
+        m_pos[order[i]] = int(i);
+}
+
+bool ArrayTour::Between(int a, int b, int c) const
+{
+    int pa = m_pos[a], pb = m_pos[b], pc = m_pos[c];
+    if(pa <= pc)
+        return pa <= pb && pb <= pc;
+    return pb >= pa || pb <= pc;
+}
+
+void ArrayTour::Reverse(int first, int last)
+{
+    const int size = Size();
+    int length = (m_pos[last] - m_pos[first] + size) % size + 1;
+    if(2*length > size)
+    {
+        int outside_first = Next(last), outside_last = Prev(first);
+        first = outside_first;
+        last = outside_last;
+        length = size - length;
+    }
+    int i = m_pos[first], j = m_pos[last];
+    for(int k = 0; k < length/2; k++)
+    {
+        swap(m_order[i], m_order[j]);
+        m_pos[m_order[i]] = i;
+        m_pos[m_order[j]] = j;
+        i = (i + 1 == size) ? 0 : i + 1;
+        j = (j == 0) ? size - 1 : j - 1;
+    }
+}
+
+void ArrayTour::MoveSegment(int first, int last, int after, bool reversed)
+{
+    // The tour runs before, [first..last], next ... after, following ...,
+    // and should become next ... after, [first..last], following ... before.
+    // Either the points from next to after shift back over the stretch, or
+    // those from following to before shift forward over it, whichever is
+    // fewer; both leave the same cyclic order.
+    const int size = Size();
+    const int length = (m_pos[last] - m_pos[first] + size) % size + 1;
+    const int before = Prev(first), next = Next(last), following = Next(after);
+    vector<int> stretch(length);
+    for(int k = 0; k < length; k++)
+        stretch[k] = m_order[(m_pos[first] + k) % size];
+    if(reversed)
+        reverse(stretch.begin(), stretch.end());
+
+    const int ahead = (m_pos[after] - m_pos[next] + size) % size + 1;
+    const int behind = (m_pos[before] - m_pos[following] + size) % size + 1;
+    int start;
+    if(ahead <= behind)
+    {
+        start = m_pos[first];
+        for(int k = 0; k < ahead; k++)
+        {
+            int to = (start + k) % size;
+            m_order[to] = m_order[(start + length + k) % size];
+            m_pos[m_order[to]] = to;
+        }
+        start = (start + ahead) % size;
+    }
+    else
+    {
+        int from_first = m_pos[following];
+        for(int k = behind - 1; k >= 0; k--)
+        {
+            int to = (from_first + length + k) % size;
+            m_order[to] = m_order[(from_first + k) % size];
+            m_pos[m_order[to]] = to;
+        }
+        start = from_first;
+    }
+    for(int k = 0; k < length; k++)
+    {
+        int to = (start + k) % size;
+        m_order[to] = stretch[k];
+        m_pos[stretch[k]] = to;
+    }
+}
+
+vector<int> ArrayTour::PathFrom(int start) const
+{
+    vector<int> path;
+    path.reserve(m_order.size() + 1);
+    for(int k = 0; k < Size(); k++)
+        path.push_back(m_order[(m_pos[start] + k) % Size()]);
+    path.push_back(start);
+    return path;
+}
+
+namespace
+{
+    // the points whose don't-look bits are clear, in the order they'll be looked at
+    class ActivePoints
+    {
+    public:
+        // every point, in tour order, unless only some are given
+        ActivePoints(const ArrayTour& tour, const vector<int>* points)
+        : m_queued(tour.Size(), points == nullptr)
+        {
+            int point = 0;
+            if(points != nullptr)
+                for(int given : *points)
+                    Push(given);
+            else
+                for(int k = 0; k < tour.Size(); k++, point = tour.Next(point))
+                    m_queue.push_back(point);
+        }
+        bool Empty() const { return m_queue.empty(); }
+        int Pop()
+        {
+            int point = m_queue.front();
+            m_queue.pop_front();
+            m_queued[point] = false;
+            return point;
+        }
+        void Push(int point)
+        {
+            if(!m_queued[point])
+            {
+                m_queued[point] = true;
+                m_queue.push_back(point);
+            }
+        }
+    private:
+        deque<int> m_queue;
+        vector<bool> m_queued;
+    };
+}
+
+// Tries to replace the tour edge from a to its successor (or predecessor)
+// and another edge with two shorter ones joining a to one of its candidates.
+static bool tryTwoOpt(const TourCosts& costs, const CandidateLists& candidates, ArrayTour& tour,
+                      ActivePoints& active, int a, unsigned long long& moves_tried)
+{
+    for(int forward = 1; forward >= 0; forward--)
+    {
+        const int b = forward ? tour.Next(a) : tour.Prev(a);
+        const double ab = costs(a, b);
+        for(const int* it = candidates.Begin(a); it != candidates.End(a); it++)
+        {
+            const int c = *it;
+            const double ac = costs(a, c);
+            // candidates are nearest first, so none further on can gain
+            if(ac >= ab - MIN_IMPROVEMENT)
+                break;
+            const int d = forward ? tour.Next(c) : tour.Prev(c);
+            if(c == b || d == a)
+                continue;
+            moves_tried++;
+            if(ac + costs(b, d) - ab - costs(c, d) < -MIN_IMPROVEMENT)
+            {
+                // a b ... c d becomes a c ... b d, or the same backwards
+                if(forward)
+                    tour.Reverse(b, c);
+                else
+                    tour.Reverse(a, d);
+                active.Push(a);
+                active.Push(b);
+                active.Push(c);
+                active.Push(d);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Tries moving a run of up to three points starting at a to between one of
+// its ends' candidates and that candidate's neighbor, either way round.
+static bool tryOrOpt(const TourCosts& costs, const CandidateLists& candidates, ArrayTour& tour,
+                     ActivePoints& active, int a, unsigned long long& moves_tried)
+{
+    const int first = a;
+    int last = a;
+    for(int length = 1; length <= MAX_OR_OPT_LENGTH && length + 3 <= tour.Size(); length++, last = tour.Next(last))
+    {
+        const int before = tour.Prev(first), next = tour.Next(last);
+        const double removal_gain = costs(before, first) + costs(last, next) - costs(before, next);
+        if(removal_gain <= MIN_IMPROVEMENT)
+            continue;
+
+        for(int end : {first, last})
+        {
+            for(const int* it = candidates.Begin(end); it != candidates.End(end); it++)
+            {
+                const int c = *it;
+                if(costs(end, c) >= removal_gain)
+                    break;
+                if(tour.Between(first, c, last))
+                    continue;
+                // put the run between c and its successor, or its predecessor
+                // and c, with end next to c
+                for(int after_c = 1; after_c >= 0; after_c--)
+                {
+                    const int u = after_c ? c : tour.Prev(c);
+                    const int v = after_c ? tour.Next(c) : c;
+                    if(u == before || tour.Between(first, u, last))
+                        continue;
+                    const bool reversed = after_c ? (end == last) : (end == first);
+                    const int run_front = reversed ? last : first, run_back = reversed ? first : last;
+                    const double added = costs(u, run_front) + costs(run_back, v) - costs(u, v);
+                    moves_tried++;
+                    if(added - removal_gain < -MIN_IMPROVEMENT)
+                    {
+                        tour.MoveSegment(first, last, u, reversed);
+                        active.Push(before);
+                        active.Push(next);
+                        active.Push(first);
+                        active.Push(last);
+                        active.Push(u);
+                        active.Push(v);
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
+
+// a move tried from one point, which returns whether it changed the tour
+typedef bool (*TryMove)(const TourCosts& costs, const CandidateLists& candidates, ArrayTour& tour,
+                        ActivePoints& active, int a, unsigned long long& moves_tried);
+
+// tries the moves from each point in turn until none helps from any point
+static unsigned long long improveTour(const TourCosts& costs, const CandidateLists& candidates,
+                                      ArrayTour& tour, const SearchDeadline& deadline, bool& hit_deadline,
+                                      const vector<int>* start_points, TryMove first_move, TryMove second_move)
+{
+    unsigned long long moves_tried = 0;
+    hit_deadline = false;
+    if(tour.Size() < 4)
+        return moves_tried;
+
+    ActivePoints active(tour, start_points);
+    for(int num_looked_at = 0; !active.Empty(); num_looked_at++)
+    {
+        if(num_looked_at % POINTS_PER_DEADLINE_CHECK == 0 && deadline.Passed())
+        {
+            hit_deadline = true;
+            break;
+        }
+        int a = active.Pop();
+        // a point that improved gets another look, since it may improve again
+        if(first_move(costs, candidates, tour, active, a, moves_tried)
+           || second_move(costs, candidates, tour, active, a, moves_tried))
+            active.Push(a);
+    }
+    return moves_tried;
+}
+
+unsigned long long improveTwoOptOrOpt(const TourCosts& costs, const CandidateLists& candidates,
+                                      ArrayTour& tour, const SearchDeadline& deadline, bool& hit_deadline,
+                                      const vector<int>* start_points)
+{
+    return improveTour(costs, candidates, tour, deadline, hit_deadline, start_points, tryTwoOpt, tryOrOpt);
+}
+
+// Swaps the tour edges (a, b) and (c, d) for (a, c) and (b, d), where d
+// is the neighbor of c the same way round the tour that b is of a; which
+// section to reverse only depends on a, b and c.
+static void exchangeEdges(ArrayTour& tour, int a, int b, int c)
+{
+    if(tour.Next(a) == b)
+        tour.Reverse(b, c);
+    else
+        tour.Reverse(c, b);
+}
+
+namespace
+{
+    // one 2-opt move of a Lin-Kernighan chain, which took out the tour edges
+    // (t2, t1) and (t3, t4) and put in (t2, t3) and (t1, t4)
+    struct ChainStep
+    {
+        int t2, t3, t4;
+    };
+}
+
+// how many 2-opt moves a Lin-Kernighan chain may take, and how many of the
+// best first moves from a point are each tried as the start of a chain
+const int MAX_CHAIN_LENGTH = 12;
+const int FIRST_MOVE_BREADTH = 5;
+
+// Chooses how a Lin-Kernighan chain at t1, whose loose end is t2 and whose
+// gain so far, before closing the tour up again, is gain, goes on: the t3
+// among t2's candidates that leaves most gain, with t4 the neighbor of t3
+// that the move takes it from. Edges the chain has put in aren't taken out.
+// Returns false if no move leaves any gain.
+static bool nextChainStep(const TourCosts& costs, const CandidateLists& candidates, const ArrayTour& tour,
+                          const vector<ChainStep>& chain, int t1, int t2, double gain,
+                          ChainStep& step, unsigned long long& moves_tried)
+{
+    bool found = false;
+    double best_score = 0;
+    const bool t1_follows = (tour.Next(t2) == t1);
+    for(const int* it = candidates.Begin(t2); it != candidates.End(t2); it++)
+    {
+        const int t3 = *it;
+        const double added = costs(t2, t3);
+        if(gain - added <= MIN_IMPROVEMENT)
+            break;
+        if(t3 == t1 || t3 == tour.Next(t2) || t3 == tour.Prev(t2))
+            continue;
+        const int t4 = t1_follows ? tour.Next(t3) : tour.Prev(t3);
+        if(t4 == t1)
+            continue;
+        bool was_added = false;
+        for(const ChainStep& earlier : chain)
+            if((earlier.t2 == t3 && earlier.t3 == t4) || (earlier.t2 == t4 && earlier.t3 == t3))
+                was_added = true;
+        if(was_added)
+            continue;
+        moves_tried++;
+        double score = costs(t3, t4) - added;
+        if(!found || score > best_score)
+        {
+            found = true;
+            best_score = score;
+            step = ChainStep{t2, t3, t4};
+        }
+    }
+    return found;
+}
+
+// Tries Lin-Kernighan chains starting from taking out the tour edge from
+// t1 to either of its neighbors.
+static bool tryLinKernighan(const TourCosts& costs, const CandidateLists& candidates, ArrayTour& tour,
+                            ActivePoints& active, int t1, unsigned long long& moves_tried)
+{
+    vector<ChainStep> chain;
+    for(int forward = 1; forward >= 0; forward--)
+    {
+        const int first_t2 = forward ? tour.Next(t1) : tour.Prev(t1);
+        const double first_gain = costs(t1, first_t2);
+
+        // the first moves, best first
+        vector<pair<double, ChainStep>> first_steps;
+        const bool t1_follows = (tour.Next(first_t2) == t1);
+        for(const int* it = candidates.Begin(first_t2); it != candidates.End(first_t2); it++)
+        {
+            const int t3 = *it;
+            if(first_gain - costs(first_t2, t3) <= MIN_IMPROVEMENT)
+                break;
+            if(t3 == t1 || t3 == tour.Next(first_t2) || t3 == tour.Prev(first_t2))
+                continue;
+            const int t4 = t1_follows ? tour.Next(t3) : tour.Prev(t3);
+            if(t4 == t1)
+                continue;
+            moves_tried++;
+            first_steps.emplace_back(costs(first_t2, t3) - costs(t3, t4), ChainStep{first_t2, t3, t4});
+        }
+        sort(first_steps.begin(), first_steps.end(),
+             [](const pair<double, ChainStep>& x, const pair<double, ChainStep>& y) { return x.first < y.first; });
+        if(first_steps.size() > size_t(FIRST_MOVE_BREADTH))
+            first_steps.resize(FIRST_MOVE_BREADTH);
+
+        for(const pair<double, ChainStep>& first_step : first_steps)
+        {
+            // follow the chain greedily from this first move, remembering
+            // where closing the tour up would have saved most
+            chain.clear();
+            double gain = first_gain;
+            double best_saving = MIN_IMPROVEMENT;
+            size_t best_length = 0;
+            ChainStep step = first_step.second;
+            int t2 = first_t2;
+            do
+            {
+                exchangeEdges(tour, step.t2, t1, step.t3);
+                chain.push_back(step);
+                gain += costs(step.t3, step.t4) - costs(t2, step.t3);
+                t2 = step.t4;
+                double saving = gain - costs(t2, t1);
+                if(saving > best_saving)
+                {
+                    best_saving = saving;
+                    best_length = chain.size();
+                }
+            }
+            while(chain.size() < size_t(MAX_CHAIN_LENGTH)
+                  && nextChainStep(costs, candidates, tour, chain, t1, t2, gain, step, moves_tried));
+
+            // take back the moves past the best point, latest first
+            while(chain.size() > best_length)
+            {
+                const ChainStep& undo = chain.back();
+                exchangeEdges(tour, undo.t2, undo.t3, t1);
+                chain.pop_back();
+            }
+            if(best_length > 0)
+            {
+                active.Push(t1);
+                for(const ChainStep& taken : chain)
+                {
+                    active.Push(taken.t2);
+                    active.Push(taken.t3);
+                    active.Push(taken.t4);
+                }
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+unsigned long long improveLinKernighan(const TourCosts& costs, const CandidateLists& candidates,
+                                       ArrayTour& tour, const SearchDeadline& deadline, bool& hit_deadline)
+{
+    return improveTour(costs, candidates, tour, deadline, hit_deadline, nullptr, tryLinKernighan, tryOrOpt);
+}
+
+namespace
+{
+    // sets of points joined so far while building a minimum spanning tree
+    class DisjointSets
+    {
+    public:
+        DisjointSets(int size)
+        : m_parent(size)
+        {
+            for(int i = 0; i < size; i++)
+                m_parent[i] = i;
+        }
+        int Find(int i)
+        {
+            while(m_parent[i] != i)
+                i = m_parent[i] = m_parent[m_parent[i]];
+            return i;
+        }
+        bool Join(int i, int j)
+        {
+            i = Find(i);
+            j = Find(j);
+            if(i == j)
+                return false;
+            m_parent[i] = j;
+            return true;
+        }
+    private:
+        vector<int> m_parent;
+    };
+
+    struct GraphEdge
+    {
+        int from, to;
+        double cost;
+    };
+}
+
+// how many penalty updates the Held-Karp search makes at most, and how many
+// in a row may fail to raise the bound before the step size is halved
+const int MAX_ASCENT_STEPS = 200;
+const int ASCENT_PATIENCE = 10;
+
+// how many nearest neighbors of each point the sparse graph joins it to;
+// more than a tour search needs, since the bound suffers for every edge of
+// the best 1-tree the graph leaves out
+const int BOUND_GRAPH_NEIGHBORS = 12;
+
+// The weight of the minimum 1-tree over the graph's edges under the
+// penalties, less twice their sum, and each point's degree in it. A 1-tree
+// is a spanning tree of every point but 0 plus the two cheapest edges at 0;
+// every tour is a 1-tree, so the lightest 1-tree is no longer than any tour.
+static double sparseOneTree(int num_points, vector<GraphEdge>& edges, const vector<double>& penalty,
+                            vector<int>& degree)
+{
+    for(GraphEdge& edge : edges)
+        edge.cost += penalty[edge.from] + penalty[edge.to];
+    sort(edges.begin(), edges.end(), [](const GraphEdge& x, const GraphEdge& y) { return x.cost < y.cost; });
+    degree.assign(num_points, 0);
+    DisjointSets joined(num_points);
+    double weight = 0;
+    int num_depot_edges = 0;
+    for(const GraphEdge& edge : edges)
+    {
+        // edges come cheapest first, so the first two at point 0 are its cheapest
+        bool take = (edge.from == 0 || edge.to == 0) ? num_depot_edges++ < 2 : joined.Join(edge.from, edge.to);
+        if(take)
+        {
+            weight += edge.cost;
+            degree[edge.from]++;
+            degree[edge.to]++;
+        }
+    }
+    for(GraphEdge& edge : edges)
+        edge.cost -= penalty[edge.from] + penalty[edge.to];
+    for(double p : penalty)
+        weight -= 2*p;
+    return weight;
+}
+
+// The same over every pair of points, by Prim's algorithm. Without a cost
+// matrix, straight line costs are replaced by the chord through the earth
+// between the points, which is never longer and far quicker to work out.
+static double completeOneTree(const TourCosts& costs, const vector<double>& penalty, const SearchDeadline& deadline)
+{
+    const int num_points = costs.Size();
+    const double earth_radius_miles = 6371.0/1.609344;
+    vector<double> x(num_points), y(num_points), z(num_points);
+    for(int i = 0; i < num_points && !costs.HasMatrix(); i++)
+    {
+        double lat = deg2rad(costs.Points()[i].latitude), lon = deg2rad(costs.Points()[i].longitude);
+        x[i] = earth_radius_miles*cos(lat)*cos(lon);
+        y[i] = earth_radius_miles*cos(lat)*sin(lon);
+        z[i] = earth_radius_miles*sin(lat);
+    }
+    auto cost = [&](int i, int j) {
+        double base = costs.HasMatrix() ? costs(i, j)
+            : sqrt((x[i] - x[j])*(x[i] - x[j]) + (y[i] - y[j])*(y[i] - y[j]) + (z[i] - z[j])*(z[i] - z[j]));
+        return base + penalty[i] + penalty[j];
+    };
+
+    // the spanning tree of points 1 on
+    const double infinity = numeric_limits<double>::infinity();
+    vector<double> reach(num_points, infinity);
+    vector<bool> in_tree(num_points, false);
+    double weight = 0;
+    int latest = 1;
+    in_tree[latest] = true;
+    for(int num_in_tree = 1; num_in_tree < num_points - 1; num_in_tree++)
+    {
+        if(num_in_tree % POINTS_PER_DEADLINE_CHECK == 0 && deadline.Passed())
+            return 0;
+        int nearest = -1;
+        for(int i = 1; i < num_points; i++)
+        {
+            if(in_tree[i])
+                continue;
+            reach[i] = min(reach[i], cost(latest, i));
+            if(nearest < 0 || reach[i] < reach[nearest])
+                nearest = i;
+        }
+        weight += reach[nearest];
+        in_tree[nearest] = true;
+        latest = nearest;
+    }
+
+    // and point 0's two cheapest edges
+    double cheapest = infinity, second = infinity;
+    for(int i = 1; i < num_points; i++)
+    {
+        double c = cost(0, i);
+        if(c < cheapest)
+        {
+            second = cheapest;
+            cheapest = c;
+        }
+        else if(c < second)
+            second = c;
+    }
+    weight += cheapest + second;
+    for(double p : penalty)
+        weight -= 2*p;
+    return weight;
+}
+
+double heldKarpBound(const TourCosts& costs, double upper_bound, const SearchDeadline& deadline)
+{
+    const int num_points = costs.Size();
+    if(num_points < 3)
+        return num_points == 2 ? 2*costs(0, 1) : 0;
+
+    // the sparse graph joins each point to its candidates, and to its
+    // neighbors along a Hilbert curve so the graph is sure to be connected
+    CandidateLists candidates(costs, BOUND_GRAPH_NEIGHBORS);
+    vector<pair<int, int>> pairs;
+    for(int i = 0; i < num_points; i++)
+        for(const int* it = candidates.Begin(i); it != candidates.End(i); it++)
+            pairs.emplace_back(min(i, *it), max(i, *it));
+    vector<int> curve = hilbertOrder(costs.Points());
+    for(int k = 0; k + 1 < num_points; k++)
+        pairs.emplace_back(min(curve[k], curve[k + 1]), max(curve[k], curve[k + 1]));
+    sort(pairs.begin(), pairs.end());
+    pairs.erase(unique(pairs.begin(), pairs.end()), pairs.end());
+    vector<GraphEdge> edges;
+    for(const pair<int, int>& p : pairs)
+        edges.push_back(GraphEdge{p.first, p.second, costs(p.first, p.second)});
+
+    // subgradient ascent: raise the penalty of points with more than two
+    // edges in the 1-tree and lower it for those with one, with steps
+    // shrinking as the bound nears the known tour
+    vector<double> penalty(num_points, 0), best_penalty = penalty;
+    vector<int> degree;
+    double best_weight = -numeric_limits<double>::infinity();
+    double step_scale = 2;
+    int num_unimproved = 0;
+    for(int step = 0; step < MAX_ASCENT_STEPS; step++)
+    {
+        if(deadline.Passed())
+            return 0;
+        double weight = sparseOneTree(num_points, edges, penalty, degree);
+        if(weight > best_weight)
+        {
+            best_weight = weight;
+            best_penalty = penalty;
+            num_unimproved = 0;
+        }
+        else if(++num_unimproved >= ASCENT_PATIENCE)
+        {
+            step_scale /= 2;
+            num_unimproved = 0;
+        }
+        double norm = 0;
+        for(int i = 0; i < num_points; i++)
+            norm += double(degree[i] - 2)*(degree[i] - 2);
+        // a 1-tree where every degree is two is a tour, and can't be beaten
+        if(norm == 0)
+            break;
+        double step_size = step_scale*max(upper_bound - weight, upper_bound*1e-6)/norm;
+        for(int i = 0; i < num_points; i++)
+            penalty[i] += step_size*(degree[i] - 2);
+    }
+    return max(0.0, completeOneTree(costs, best_penalty, deadline));
+}
+
+// The least of row[i] + costs[i] over the first width entries. Unreachable
+// entries hold infinity, so the sum needs no test for them, and with SSE2
+// two entries are taken at once.
+static double leastSum(const double* row, const double* costs, int width)
+{
+    double least = numeric_limits<double>::infinity();
+    int i = 0;
+#ifdef __SSE2__
+    __m128d least_pair = _mm_set1_pd(least);
+    for(; i + 2 <= width; i += 2)
+        least_pair = _mm_min_pd(least_pair, _mm_add_pd(_mm_loadu_pd(row + i), _mm_loadu_pd(costs + i)));
+    double pair[2];
+    _mm_storeu_pd(pair, least_pair);
+    least = min(pair[0], pair[1]);
+#endif
+    for(; i < width; i++)
+        least = min(least, row[i] + costs[i]);
+    return least;
+}
+
+vector<int> solveHeldKarp(const TourCosts& costs)
+{
+    const int num_stops = costs.Size() - 1;
+    vector<int> path(1, 0);
+    if(num_stops <= 0 || num_stops > MAX_EXACT_POINTS)
+    {
+        for(int i = 1; i <= num_stops; i++)
+            path.push_back(i);
+        path.push_back(0);
+        return path;
+    }
+
+    // Stop i is point i + 1. shortest[set*num_stops + i] is the length of
+    // the shortest path from the depot through the stops in set, a bitmask,
+    // ending at stop i. Each set's row is built only from rows of smaller
+    // sets, which come before it, and from one row of the cost matrix, so
+    // both are read straight through.
+    const double infinity = numeric_limits<double>::infinity();
+    const size_t num_sets = size_t(1) << num_stops;
+    vector<double> stop_costs(size_t(num_stops)*num_stops);
+    for(int i = 0; i < num_stops; i++)
+        for(int j = 0; j < num_stops; j++)
+            stop_costs[size_t(i)*num_stops + j] = costs(i + 1, j + 1);
+    vector<double> shortest(num_sets*num_stops, infinity);
+    for(int i = 0; i < num_stops; i++)
+        shortest[(size_t(1) << i)*num_stops + i] = costs(0, i + 1);
+    for(size_t set = 1; set < num_sets; set++)
+    {
+        if((set & (set - 1)) == 0)
+            continue;
+        for(int last = 0; last < num_stops; last++)
+            if(set & (size_t(1) << last))
+            {
+                // costs are symmetric, so the costs into last are its row
+                const size_t rest = set ^ (size_t(1) << last);
+                shortest[set*num_stops + last] = leastSum(&shortest[rest*num_stops],
+                                                          &stop_costs[size_t(last)*num_stops], num_stops);
+            }
+    }
+
+    // Close the best path back at the depot, then walk back through the
+    // table, finding which stop each best path came from by redoing its sum.
+    // The stop with the least sum is taken rather than one matching the
+    // table exactly, which needn't happen if the sums round differently.
+    size_t set = num_sets - 1;
+    int last = 0;
+    double best = infinity;
+    for(int i = 0; i < num_stops; i++)
+        if(shortest[set*num_stops + i] + costs(i + 1, 0) < best)
+        {
+            best = shortest[set*num_stops + i] + costs(i + 1, 0);
+            last = i;
+        }
+    vector<int> reversed;
+    for(;;)
+    {
+        reversed.push_back(last + 1);
+        const size_t rest = set ^ (size_t(1) << last);
+        if(rest == 0)
+            break;
+        int previous = -1;
+        double previous_length = infinity;
+        for(int i = 0; i < num_stops; i++)
+        {
+            if(!(rest & (size_t(1) << i)))
+                continue;
+            const double length = shortest[rest*num_stops + i] + stop_costs[size_t(last)*num_stops + i];
+            if(previous < 0 || length < previous_length)
+            {
+                previous = i;
+                previous_length = length;
+            }
+        }
+        set = rest;
+        last = previous;
+    }
+    path.insert(path.end(), reversed.rbegin(), reversed.rend());
+    path.push_back(0);
+    return path;
+}
@@ -0,0 +1,154 @@
+//  Author:  Noah Himed
+//  Date:    16 October 2026
+//  Summary: Building blocks shared by the DeliveryOptimizer's tour search
+//           engines: the costs between stops, each stop's nearest
+//           neighbors, and a tour kept in an array with its inverse.
+
+#ifndef TOUR_SEARCH_INCLUDED
+#define TOUR_SEARCH_INCLUDED
+
+#include "provided.h"
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+// Above this many points costs are worked out as they're needed rather than
+// kept in a matrix, which would take 8 bytes per pair.
+const std::size_t MAX_MATRIX_POINTS = 2048;
+
+// The cost of travelling between any two points of a tour, by index.
+// Costs are symmetric, which lets reversing part of a tour be costed by
+// looking only at its two ends.
+class TourCosts
+{
+public:
+    TourCosts(const std::vector<GeoCoord>& points)
+    : m_points(points), m_num_points(points.size())
+    {}
+    // keeps every cost in a matrix, row by row
+    void UseMatrix(std::vector<double>& matrix) { m_matrix.swap(matrix); }
+    double operator()(int from, int to) const
+    {
+        if(m_matrix.empty())
+            return distanceEarthMiles(m_points[from], m_points[to]);
+        return m_matrix[from*m_num_points + to];
+    }
+    int Size() const { return int(m_num_points); }
+    bool HasMatrix() const { return !m_matrix.empty(); }
+    // the costs between just the points at indices, in that order
+    TourCosts Subset(const std::vector<int>& indices) const;
+    const std::vector<GeoCoord>& Points() const { return m_points; }
+private:
+    std::vector<GeoCoord> m_points;
+    std::size_t m_num_points;
+    std::vector<double> m_matrix;
+};
+
+// the wall clock time a search has to finish by, if any
+struct SearchDeadline
+{
+    SearchDeadline()
+    : has_deadline(false)
+    {}
+    bool Passed() const { return has_deadline && std::chrono::steady_clock::now() >= deadline; }
+
+    bool has_deadline;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point deadline;
+};
+
+// The few points nearest each point, by cost, found through a uniform grid
+// over the points' positions, so building them takes about linear time.
+// Good tours almost only join points to near neighbors, so searches that
+// only try joining each point to its candidates lose little and save a lot.
+class CandidateLists
+{
+public:
+    CandidateLists(const TourCosts& costs, int num_candidates);
+    // a point's candidates, nearest first
+    const int* Begin(int point) const { return &m_candidates[std::size_t(point)*m_num_candidates]; }
+    const int* End(int point) const { return Begin(point) + m_num_candidates; }
+private:
+    std::size_t m_num_candidates;
+    std::vector<int> m_candidates;
+};
+
+// the indices of points in the order a Hilbert curve over them visits them,
+// a quick tour that keeps nearby points together
+std::vector<int> hilbertOrder(const std::vector<GeoCoord>& points);
+
+// A tour through every point, kept as the order of the points and each
+// point's position in it, so stepping along the tour and telling whether a
+// point lies between two others both take constant time.
+class ArrayTour
+{
+public:
+    explicit ArrayTour(const std::vector<int>& order);
+    int Size() const { return int(m_order.size()); }
+    int Next(int point) const
+    {
+        int pos = m_pos[point] + 1;
+        return m_order[pos == Size() ? 0 : pos];
+    }
+    int Prev(int point) const
+    {
+        int pos = m_pos[point];
+        return m_order[pos == 0 ? Size() - 1 : pos - 1];
+    }
+    // whether b is met going forward from a no later than c
+    bool Between(int a, int b, int c) const;
+    // Reverses the stretch going forward from first to last. Reversing the
+    // rest of the tour instead gives the same tour the other way round, so
+    // whichever stretch is shorter is the one reversed.
+    void Reverse(int first, int last);
+    // moves the stretch going forward from first to last so it sits just
+    // after the point after, reversed if asked; after must lie outside the
+    // stretch and not just before it
+    void MoveSegment(int first, int last, int after, bool reversed);
+    // the tour as a path from start round and back to start
+    std::vector<int> PathFrom(int start) const;
+private:
+    std::vector<int> m_order;
+    std::vector<int> m_pos;
+};
+
+// the most points besides the first that solveHeldKarp will take; its
+// table takes 2^n rows of n costs
+const int MAX_EXACT_POINTS = 16;
+
+// The shortest tour through every point, as a path from point 0 back to
+// point 0, by the Held-Karp dynamic program over subsets of the other points.
+// Takes time n^2 2^n and space n 2^n for n points besides the first.
+std::vector<int> solveHeldKarp(const TourCosts& costs);
+
+// Improves tour with 2-opt moves and Or-opt moves of up to three points,
+// only joining points to their candidates. Points whose neighborhood hasn't
+// changed since they last failed to improve are skipped (their don't-look
+// bit is set), so each pass after the first only revisits where the tour
+// changed. Returns how many moves were tried; hit_deadline is set if the
+// search stopped at the deadline rather than at a local optimum. Given
+// start_points, only those points are looked at to begin with, for a tour
+// known to be locally optimal everywhere else.
+unsigned long long improveTwoOptOrOpt(const TourCosts& costs, const CandidateLists& candidates,
+                                      ArrayTour& tour, const SearchDeadline& deadline, bool& hit_deadline,
+                                      const std::vector<int>* start_points = nullptr);
+
+// Improves tour with Lin-Kernighan style moves: chains of up to a dozen
+// 2-opt moves, each joining the loose end of the last to one of its
+// candidates, kept as far as the chain's best point if that shortens the
+// tour; where no chain helps, Or-opt moves are tried as above. Returns and
+// sets hit_deadline as improveTwoOptOrOpt does.
+unsigned long long improveLinKernighan(const TourCosts& costs, const CandidateLists& candidates,
+                                       ArrayTour& tour, const SearchDeadline& deadline, bool& hit_deadline);
+
+// A lower bound on the length of any tour through the points: the Held-Karp
+// bound, the longest of the minimum 1-trees found as penalties on each
+// point's costs push the 1-tree's degrees towards two. The penalties are
+// searched for over a sparse graph joining each point to its nearest
+// neighbors; the final 1-tree is over every pair of points, so the bound
+// holds whatever was left out. upper_bound, the length of a known tour, sets
+// the step sizes. Returns 0 if the deadline passes first.
+double heldKarpBound(const TourCosts& costs, double upper_bound, const SearchDeadline& deadline);
+
+#endif // TOUR_SEARCH_INCLUDED